@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "kickcat/Bus.h"
+#include "ESCSlavesSocket.h"
+
+using namespace kickcat;
+
+// Measure the bus init time, dominated by the SII fetch (no network: slaves are emulated by the socket). Each EEPROM
+// read request keeps the slave EEPROM interface busy for EEPROM_LATENCY (twice for 8 bytes reads).
+
+constexpr nanoseconds TINY_WAIT      = 200us;   // Bus default
+constexpr nanoseconds BIG_WAIT       = 1ms;     // state polling interval (upper bound)
+constexpr nanoseconds EEPROM_LATENCY = 50us;    // 4 bytes read on the I2C bus
+
+struct Result
+{
+    nanoseconds time;
+    int32_t frames;
+};
+
+
+/// \brief Previous behavior: broadcast EEPROM request, wait for all slaves to be ready, then read the data word (4 bytes)
+class BroadcastFetchBus : public Bus
+{
+public:
+    using Bus::Bus;
+
+    void init()
+    {
+        resetBus();
+        fetchEeprom();
+        enterPreOp();
+    }
+
+private:
+    bool areEepromReady()
+    {
+        bool ready = true;
+        auto process = [&ready](DatagramHeader const*, uint8_t const* data, uint16_t wkc)
+        {
+            if (wkc != 1)
+            {
+                return true;
+            }
+            if (*reinterpret_cast<uint16_t const*>(data) & 0x8000)
+            {
+                ready = false;
+            }
+            return false;
+        };
+        auto error = []() { THROW_ERROR("Error while fetching eeprom state"); };
+
+        for (int i = 0; i < 10; ++i)
+        {
+            sleep(tiny_wait);
+            for (auto& slave : slaves_)
+            {
+                link_.addDatagram(Command::FPRD, createAddress(slave.address, reg::EEPROM_CONTROL), nullptr, 2, process, error);
+            }
+            ready = true;
+            link_.processDatagrams();
+            if (ready)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void readEeprom(uint16_t address, std::vector<Slave*> const& slaves, std::function<void(Slave&, uint32_t)> apply)
+    {
+        uint16_t request[3] = { eeprom::Command::READ, address, 0 };
+        if (broadcastWrite(reg::EEPROM_CONTROL, request, sizeof(request)) != slaves_.size())
+        {
+            THROW_ERROR("Invalid working counter");
+        }
+        if (not areEepromReady())
+        {
+            THROW_ERROR("Timeout");
+        }
+
+        auto error = []() { THROW_ERROR("Invalid working counter"); };
+        for (auto& slave : slaves)
+        {
+            auto process = [&slave, &apply](DatagramHeader const*, uint8_t const* data, uint16_t wkc)
+            {
+                if (wkc != 1)
+                {
+                    return true;
+                }
+                apply(*slave, *reinterpret_cast<uint32_t const*>(data));
+                return false;
+            };
+            link_.addDatagram(Command::FPRD, createAddress(slave->address, reg::EEPROM_DATA), nullptr, 4, process, error);
+        }
+        link_.processDatagrams();
+    }
+
+    void fetchEeprom()
+    {
+        std::vector<Slave*> slaves;
+        for (auto& slave : slaves_)
+        {
+            slaves.push_back(&slave);
+        }
+
+        readEeprom(eeprom::VENDOR_ID,       slaves, [](Slave& s, uint32_t word) { s.vendor_id       = word; });
+        readEeprom(eeprom::PRODUCT_CODE,    slaves, [](Slave& s, uint32_t word) { s.product_code    = word; });
+        readEeprom(eeprom::REVISION_NUMBER, slaves, [](Slave& s, uint32_t word) { s.revision_number = word; });
+        readEeprom(eeprom::SERIAL_NUMBER,   slaves, [](Slave& s, uint32_t word) { s.serial_number   = word; });
+        readEeprom(eeprom::STANDARD_MAILBOX + eeprom::RECV_MBO_OFFSET, slaves,
+        [](Slave& s, uint32_t word) { s.mailbox.recv_offset = word; s.mailbox.recv_size = word >> 16; });
+        readEeprom(eeprom::STANDARD_MAILBOX + eeprom::SEND_MBO_OFFSET, slaves,
+        [](Slave& s, uint32_t word) { s.mailbox.send_offset = word; s.mailbox.send_size = word >> 16; });
+        readEeprom(eeprom::MAILBOX_PROTOCOL, slaves,
+        [](Slave& s, uint32_t word) { s.supported_mailbox = static_cast<eeprom::MailboxProtocol>(word); });
+        readEeprom(eeprom::EEPROM_SIZE, slaves,
+        [](Slave& s, uint32_t word) { s.eeprom_size = ((word & 0xFF) + 1) * 128; s.eeprom_version = word >> 16; });
+
+        int32_t pos = 0;
+        while (not slaves.empty())
+        {
+            readEeprom(eeprom::START_CATEGORY + pos, slaves, [](Slave& s, uint32_t word) { s.sii.buffer.push_back(word); });
+            pos += 2;
+            slaves.erase(std::remove_if(slaves.begin(), slaves.end(),
+                [](Slave* s) { return ((s->sii.buffer.back() >> 16) == eeprom::Category::End); }),
+                slaves.end());
+        }
+
+        for (auto& slave : slaves_)
+        {
+            slave.parseSII();
+        }
+    }
+};
+
+
+template<typename BusType>
+Result init(int32_t slaves_count, std::string const& sii_cache = "", BusConfig* config = nullptr)
+{
+    auto socket = std::make_shared<ESCSlavesSocket>();
+    socket->setEepromLatency(EEPROM_LATENCY);
+    for (int32_t i = 0; i < slaves_count; ++i)
+    {
+        // SII from 52 to 252 words of categories (mostly strings): short and long ones are mixed on the chain
+        socket->addSlave(ESCSlavesSocket::createSII(0x6A5, i, static_cast<uint16_t>((i % 5) * 50)));
+    }
+
+    BusType bus(socket);
+    bus.configureWaitLatency(TINY_WAIT, BIG_WAIT);
+    if constexpr (std::is_same_v<BusType, Bus>)
+    {
+        bus.setSIICache(sii_cache);
+    }
+
+    nanoseconds start = since_epoch();
+    if constexpr (std::is_same_v<BusType, Bus>)
+    {
+        if (config != nullptr)
+        {
+            if (config->slaves.empty())
+            {
+                bus.init();
+                *config = BusConfig::fromSlaves(bus.slaves());  // describe the bus once
+            }
+            else
+            {
+                bus.init(*config);
+            }
+            return {elapsed_time(start), socket->frames};
+        }
+    }
+    bus.init();
+    return {elapsed_time(start), socket->frames};
+}
+
+
+int main()
+{
+    printf("Bus init (emulated slaves, %ld us per 4 bytes EEPROM read, state polling up to %ld ms)\n",
+           EEPROM_LATENCY.count() / 1000, BIG_WAIT.count() / 1000000);
+    printf("%-8s | %-26s | %-26s | %-26s | %s\n", "slaves", "broadcast 4 bytes", "pipelined 8 bytes", "SII cache (restart)", "bus configuration");
+    for (int32_t slaves_count : {1, 10, 50, 100})
+    {
+        char cache[] = "/tmp/kickcat_sii_XXXXXX";
+        if (mkdtemp(cache) == nullptr)
+        {
+            THROW_SYSTEM_ERROR("mkdtemp()");
+        }
+
+        Result before  = init<BroadcastFetchBus>(slaves_count);
+        Result after   = init<Bus>(slaves_count);
+        init<Bus>(slaves_count, cache);                     // fill the cache
+        Result restart = init<Bus>(slaves_count, cache);
+        BusConfig config;
+        init<Bus>(slaves_count, "", &config);               // describe the bus
+        Result offline = init<Bus>(slaves_count, "", &config);
+        printf("%-8d | %8ld us - %5d frames | %8ld us - %5d frames | %8ld us - %5d frames | %8ld us - %5d frames\n", slaves_count,
+               before.time.count()  / 1000, before.frames,
+               after.time.count()   / 1000, after.frames,
+               restart.time.count() / 1000, restart.frames,
+               offline.time.count() / 1000, offline.frames);
+
+        std::string clean = std::string("rm -rf ") + cache;
+        if (system(clean.c_str()) != 0)
+        {
+            printf("cannot remove %s\n", cache);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include "kickcat/Bus.h"
+#include "CoESlavesSocket.h"
+
+using namespace kickcat;
+
+// Measure the startup time of the CoE mapping detection (no network: slaves are emulated by the socket and answer
+// their mailbox on the next check). Time is dominated by the mailbox rounds, each one waiting the bus tiny latency.
+
+constexpr nanoseconds TINY_WAIT = 200us;   // Bus default
+
+struct Result
+{
+    nanoseconds time;
+    int32_t check_frames;  // mailboxes check frames sent
+};
+
+
+/// \brief Previous behavior: one blocking SDO read at a time, slave after slave
+Result sequential(int32_t slaves_count)
+{
+    auto socket = std::make_shared<CoESlavesSocket>();
+    Bus bus(socket);
+    bus.configureWaitLatency(TINY_WAIT, 10ms);
+    for (int32_t i = 0; i < slaves_count; ++i)
+    {
+        socket->addSlave(bus.slaves(), static_cast<uint16_t>(0x1000 + i));
+    }
+
+    nanoseconds start = since_epoch();
+    for (auto& slave : bus.slaves())
+    {
+        uint8_t sm[16];
+        uint32_t sm_size = sizeof(sm);
+        bus.readSDO(slave, CoE::SM_COM_TYPE, 1, Bus::Access::EMULATE_COMPLETE, sm, &sm_size);
+        for (uint32_t i = 2; i < sm_size; ++i)
+        {
+            uint16_t mapped_index[16];
+            uint32_t map_size = sizeof(mapped_index);
+            bus.readSDO(slave, CoE::SM_CHANNEL + i, 1, Bus::Access::EMULATE_COMPLETE, mapped_index, &map_size);
+            for (uint32_t j = 0; j < (map_size / 2); ++j)
+            {
+                uint8_t object[64];
+                uint32_t object_size = sizeof(object);
+                bus.readSDO(slave, mapped_index[j], 1, Bus::Access::EMULATE_COMPLETE, object, &object_size);
+            }
+        }
+    }
+    return {elapsed_time(start), socket->mailbox_check_frames};
+}
+
+
+/// \brief Every slave mailbox read at the same time (Bus::createMapping)
+Result concurrent(int32_t slaves_count)
+{
+    auto socket = std::make_shared<CoESlavesSocket>();
+    Bus bus(socket);
+    bus.configureWaitLatency(TINY_WAIT, 10ms);
+    for (int32_t i = 0; i < slaves_count; ++i)
+    {
+        socket->addSlave(bus.slaves(), static_cast<uint16_t>(0x1000 + i));
+    }
+
+    std::vector<uint8_t> iomap(slaves_count * 10);
+    nanoseconds start = since_epoch();
+    bus.createMapping(iomap.data());
+    return {elapsed_time(start), socket->mailbox_check_frames};
+}
+
+
+int main()
+{
+    printf("CoE mapping detection (emulated slaves, %ld us per mailbox round, frames: mailboxes check frames)\n", TINY_WAIT.count() / 1000);
+    printf("%-8s | %-26s | %s\n", "slaves", "sequential", "concurrent");
+    for (int32_t slaves_count : {1, 10, 50, 100})
+    {
+        Result before = sequential(slaves_count);
+        Result after  = concurrent(slaves_count);
+        printf("%-8d | %8ld ms - %5d frames | %8ld ms - %5d frames\n", slaves_count,
+               before.time.count() / 1000000, before.check_frames,
+               after.time.count()  / 1000000, after.check_frames);
+    }
+
+    return 0;
+}
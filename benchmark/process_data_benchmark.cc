@@ -0,0 +1,160 @@
+#include "kickcat/Bus.h"
+#include "kickcat/Frame.h"
+
+#include <cstring>
+#include <algorithm>
+
+using namespace kickcat;
+
+// Measure the master side cost of one cyclic exchange (no network: frames are answered by a loopback socket)
+
+constexpr int32_t CYCLES = 20000;
+
+// Answer every datagram as if all the slaves processed it
+class LoopbackSocket : public AbstractSocket
+{
+public:
+    void open(std::string const&, microseconds) override {}
+    void close() noexcept override {}
+
+    int32_t write(uint8_t const* frame, int32_t frame_size) override
+    {
+        auto& answer = frames_[head_ % frames_.size()];
+        std::memcpy(answer.data(), frame, frame_size);
+        sizes_[head_ % frames_.size()] = frame_size;
+        ++head_;
+
+        uint8_t* pos = answer.data() + sizeof(EthernetHeader) + sizeof(EthercatHeader);
+        DatagramHeader* header;
+        do
+        {
+            header = reinterpret_cast<DatagramHeader*>(pos);
+            uint16_t* wkc = reinterpret_cast<uint16_t*>(pos + sizeof(DatagramHeader) + header->len);
+            *wkc = expectedWKC(header);
+            pos += datagram_size(header->len);
+        } while (header->multiple);
+
+        return frame_size;
+    }
+
+    int32_t read(uint8_t* frame, int32_t) override
+    {
+        auto& answer = frames_[tail_ % frames_.size()];
+        int32_t size = sizes_[tail_ % frames_.size()];
+        ++tail_;
+        std::memcpy(frame, answer.data(), size);
+        return size;
+    }
+
+    // logical datagrams answers are built from the PI layout
+    void setPlan(MappingPlanner::Plan const& plan) { frames_plan_ = plan.frames; }
+
+private:
+    uint16_t expectedWKC(DatagramHeader const* header) const
+    {
+        for (auto const& frame : frames_plan_)
+        {
+            if (frame.address != header->address)
+            {
+                continue;
+            }
+
+            switch (header->command)
+            {
+                case Command::LRD: { return static_cast<uint16_t>(frame.inputs);  }
+                case Command::LWR: { return static_cast<uint16_t>(frame.outputs); }
+                case Command::LRW: { return static_cast<uint16_t>(frame.inputs + 2 * frame.outputs); }
+                default:           { break; }
+            }
+        }
+        return 1;
+    }
+
+    std::vector<MappingPlanner::PIFrame> frames_plan_;
+    std::array<EthernetFrame, 64> frames_;
+    std::array<int32_t, 64> sizes_;
+    uint32_t head_{0};
+    uint32_t tail_{0};
+};
+
+
+/// \param pi_sizes PI size of each slave (same size for inputs and outputs)
+/// \param input_changes enable the input change detection
+nanoseconds benchmark(std::vector<int32_t> const& pi_sizes, bool zero_copy, bool input_changes = false)
+{
+    auto socket = std::make_shared<LoopbackSocket>();
+    Bus bus(socket);
+
+    eeprom::SyncManagerEntry outputs_sm{0x1000, 0, 0x64, 0, 1, 3};
+    eeprom::SyncManagerEntry inputs_sm {0x1800, 0, 0x20, 0, 1, 4};
+    int32_t iomap_size = 0;
+    for (size_t i = 0; i < pi_sizes.size(); ++i)
+    {
+        Slave slave{};
+        slave.address = static_cast<uint16_t>(0x1000 + i);
+        slave.is_static_mapping = true;
+        slave.sii.syncManagers_ = {&outputs_sm, &inputs_sm};
+        slave.output = {nullptr, 0, pi_sizes[i], 0, 0, 0, false};
+        slave.input  = {nullptr, 0, pi_sizes[i], 1, 0, 0, false};
+        bus.slaves().push_back(slave);
+        iomap_size += pi_sizes[i] * 2;
+    }
+
+    std::vector<uint8_t> iomap(iomap_size);
+    if (zero_copy)
+    {
+        bus.createZeroCopyMapping();
+    }
+    else
+    {
+        bus.createMapping(iomap.data());
+    }
+    socket->setPlan(bus.mappingPlan());
+    bus.enableInputChanges(input_changes);
+
+    auto error = [](){ THROW_ERROR("Invalid working counter"); };
+
+    // warm up
+    for (int32_t i = 0; i < 1000; ++i)
+    {
+        bus.processDataReadWrite(error);
+    }
+
+    nanoseconds start = since_epoch();
+    for (int32_t i = 0; i < CYCLES; ++i)
+    {
+        bus.processDataReadWrite(error);
+    }
+    return elapsed_time(start) / CYCLES;
+}
+
+
+int main()
+{
+    printf("LRW cycle cost (master side, loopback socket)\n");
+    printf("%-24s | client buffer | zero-copy | client buffer + changes | zero-copy + changes\n", "PI");
+    auto run = [](char const* name, std::vector<int32_t> const& pi_sizes)
+    {
+        nanoseconds copy              = benchmark(pi_sizes, false);
+        nanoseconds zero_copy         = benchmark(pi_sizes, true);
+        nanoseconds copy_changes      = benchmark(pi_sizes, false, true);
+        nanoseconds zero_copy_changes = benchmark(pi_sizes, true,  true);
+        printf("%-24s | %10ld ns | %6ld ns | %20ld ns | %16ld ns\n", name,
+               copy.count(), zero_copy.count(), copy_changes.count(), zero_copy_changes.count());
+    };
+
+    // big slaves: one slave per PI frame
+    run("1 frame",  std::vector<int32_t>(1,  1400));
+    run("4 frames", std::vector<int32_t>(4,  1400));
+    run("16 frames", std::vector<int32_t>(16, 1400));
+
+    // many small slaves: per block copy overhead dominates
+    std::vector<int32_t> small;
+    for (int32_t i = 0; i < 300; ++i)
+    {
+        small.push_back(1 + i % 4);
+    }
+    run("300 slaves of 1-4 bytes", small);
+
+    return 0;
+}
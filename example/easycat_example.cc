@@ -1,4 +1,5 @@
 #include "kickcat/Bus.h"
+#include "kickcat/CyclicEngine.h"
 #include "kickcat/LinuxSocket.h"
 
 #include <iostream>
@@ -82,65 +83,67 @@ int main(int argc, char* argv[])
         return 1;
     }
 
-    constexpr int64_t LOOP_NUMBER = 12 * 3600 * 1000; // 12h
+    constexpr int64_t LOOP_NUMBER = 12 * 3600 * 50; // 12h
     FILE* stat_file = fopen("stats.csv", "w");
     fwrite("latency\n", 1, 8, stat_file);
 
     auto& easycat = bus.slaves().at(0);
-    int64_t last_error = 0;
-    for (int64_t i = 0; i < LOOP_NUMBER; ++i)
+    int64_t i = 0;
+    int64_t errors = 0;
+    auto cycle_error = [&](){ ++errors; };
+
+    CyclicEngine engine(bus, 20ms);
+    engine.setPreSend([&]()
+    {
+        bus.sendrefreshErrorCounters(cycle_error);
+        bus.sendMailboxesChecks(cycle_error);
+        bus.sendReadMessages(cycle_error);
+        bus.sendWriteMessages(cycle_error);
+    });
+    engine.setPostReceive([&]()
     {
-        sleep(20ms);
+        for (int32_t j = 0;  j < easycat.input.bsize; ++j)
+        {
+            printf("%02x ", easycat.input.data[j]);
+        }
+        printf("\r");
 
-        try
+        // blink a led - EasyCAT example for Arduino
+        if ((i % 50) < 25)
         {
-            nanoseconds t1 = since_epoch();
-            bus.sendLogicalRead(callback_error);
-            bus.sendLogicalWrite(callback_error);
-            bus.sendrefreshErrorCounters(callback_error);
-            bus.sendMailboxesChecks(callback_error);
-            bus.sendReadMessages(callback_error);
-            bus.sendWriteMessages(callback_error);
-            nanoseconds t2 = since_epoch();
-
-
-            nanoseconds t3 = since_epoch();
-            bus.processAwaitingFrames();
-            nanoseconds t4 = since_epoch();
-
-            for (int32_t j = 0;  j < easycat.input.bsize; ++j)
-            {
-                printf("%02x ", easycat.input.data[j]);
-            }
-            printf("\r");
-
-            // blink a led - EasyCAT example for Arduino
-            if ((i % 50) < 25)
-            {
-                easycat.output.data[0] = 1;
-            }
-            else
-            {
-                easycat.output.data[0] = 0;
-            }
-
-            if ((i % 1000) == 0)
-            {
-                easycat.printErrorCounters();
-            }
-
-            microseconds sample = duration_cast<microseconds>(t4 - t3 + t2 - t1);
-            std::string sample_str = std::to_string(sample.count());
-            fwrite(sample_str.data(), 1, sample_str.size(), stat_file);
-            fwrite("\n", 1, 1, stat_file);
+            easycat.output.data[0] = 1;
         }
-        catch (std::exception const& e)
+        else
         {
-            int64_t delta = i - last_error;
-            last_error = i;
-            std::cerr << e.what() << " at " << i << " delta: " << delta << std::endl;
+            easycat.output.data[0] = 0;
         }
+
+        if ((i % 1000) == 0)
+        {
+            easycat.printErrorCounters();
+        }
+        ++i;
+
+        // latency: from the cycle deadline to the inputs processing
+        microseconds sample = duration_cast<microseconds>(monotonic_time() - engine.cycleStart());
+        std::string sample_str = std::to_string(sample.count());
+        fwrite(sample_str.data(), 1, sample_str.size(), stat_file);
+        fwrite("\n", 1, 1, stat_file);
+    });
+
+    try
+    {
+        engine.run(LOOP_NUMBER);
     }
+    catch (std::exception const& e)
+    {
+        std::cerr << e.what() << " at " << i << std::endl;
+    }
+
+    auto const& stats = engine.statistics();
+    printf("\ncycles: %ld - errors: %ld (PI) %ld (others) - overruns: %ld - late wake-ups: %ld - max cycle time: %ld us\n",
+           stats.cycles, stats.errors, errors, stats.overruns, stats.late_wakeups,
+           duration_cast<microseconds>(stats.max_cycle_time).count());
 
     fclose(stat_file);
 
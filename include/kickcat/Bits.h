@@ -0,0 +1,86 @@
+#ifndef KICKCAT_BITS_H
+#define KICKCAT_BITS_H
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+namespace kickcat
+{
+    // Bit accurate helpers to access a process image.
+    // Bits are numbered LSB first, as in EtherCAT logical frames: bit 0 is the LSB of data[0], bit 8 the LSB of data[1]...
+
+    /// \return a mask with the 'bits' lower bits set (up to 64)
+    constexpr uint64_t bitMask(int32_t bits)
+    {
+        if (bits >= 64)
+        {
+            return UINT64_MAX;
+        }
+        return (uint64_t{1} << bits) - 1;
+    }
+
+    /// \brief read 'size' bits (up to 64) starting at bit 'offset' of 'data'
+    inline uint64_t readBits(uint8_t const* data, int32_t offset, int32_t size)
+    {
+        data   += offset / 8;
+        offset %= 8;
+
+        uint64_t value = 0;
+        int32_t  done  = 0;
+        while (done < size)
+        {
+            int32_t chunk = std::min(8 - offset, size - done);
+            value |= static_cast<uint64_t>((*data >> offset) & bitMask(chunk)) << done;
+            done  += chunk;
+            offset = 0;
+            ++data;
+        }
+        return value;
+    }
+
+    /// \brief write the 'size' lower bits (up to 64) of 'value' at bit 'offset' of 'data'. Others bits are left untouched.
+    inline void writeBits(uint8_t* data, int32_t offset, int32_t size, uint64_t value)
+    {
+        data   += offset / 8;
+        offset %= 8;
+
+        int32_t done = 0;
+        while (done < size)
+        {
+            int32_t chunk = std::min(8 - offset, size - done);
+            uint8_t mask  = static_cast<uint8_t>(bitMask(chunk) << offset);
+            uint8_t bits  = static_cast<uint8_t>(((value >> done) & bitMask(chunk)) << offset);
+            *data = static_cast<uint8_t>((*data & ~mask) | bits);
+            done  += chunk;
+            offset = 0;
+            ++data;
+        }
+    }
+
+    /// \brief copy 'size' bytes of 'src' in 'dst'
+    /// \return true if 'dst' content changed
+    /// \details compare and copy are done in one pass, a word at once (vectorized by the compiler)
+    inline bool copyChanged(uint8_t* dst, uint8_t const* src, int32_t size)
+    {
+        uint64_t diff = 0;
+        int32_t i = 0;
+        for (; (i + 8) <= size; i += 8)
+        {
+            uint64_t previous;
+            uint64_t current;
+            std::memcpy(&previous, dst + i, sizeof(uint64_t));
+            std::memcpy(&current,  src + i, sizeof(uint64_t));
+            diff |= previous ^ current;
+            std::memcpy(dst + i, &current, sizeof(uint64_t));
+        }
+        for (; i < size; ++i)
+        {
+            diff |= dst[i] ^ src[i];
+            dst[i] = src[i];
+        }
+        return diff != 0;
+    }
+}
+
+#endif
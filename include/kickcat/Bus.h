@@ -1,6 +1,7 @@
 #ifndef KICKCAT_BUS_H
 #define KICKCAT_BUS_H
 
+#include <deque>
 #include <memory>
 #include <tuple>
 #include <list>
@@ -10,8 +11,13 @@
 #include "Error.h"
 #include "Frame.h"
 #include "Link.h"
+#include "BusConfig.h"
+#include "MappingPlanner.h"
+#include "SIICache.h"
+#include "Signal.h"
 #include "Slave.h"
 #include "Time.h"
+#include "Tracer.h"
 
 namespace kickcat
 {
@@ -27,27 +33,119 @@ namespace kickcat
         void configureWaitLatency(nanoseconds tiny, nanoseconds big)
         { tiny_wait = tiny; big_wait = big; }
 
+        // Cache the slaves SII in 'directory' (empty: disabled): init() reads the identity of a known slave only
+        void setSIICache(std::string const& directory) { sii_cache_ = SIICache(directory); }
+
+        // Record the bus operations timeline in 'tracer' (nullptr: disabled) - see Tracer
+        void setTracer(Tracer* tracer) { tracer_ = tracer; link_.setTracer(tracer); }
+
         // set the bus from an unknown state to PREOP state
         void init();
 
+        // Same from an expected configuration, without discovery (no SII parsing, no mapping detection): the slaves
+        // identities are verified (ErrorCode code: slaves count or position of the first mismatching slave), mailboxes,
+        // SyncManagers and PI mapping come from the configuration and its startup SDOs are written in PRE_OP.
+        // The FMMUs are programmed by createMapping() from this mapping as usual.
+        void init(BusConfig const& config);
+
+        // Warm attach to a running bus (i.e. after a master restart), without resetting the slaves: slaves station addresses,
+        // states, identities, SyncManagers and FMMUs are read and checked against the expected configuration, and the
+        // mapping on the client buffer is computed again from it (same mapping planner settings than the previous master)
+        // without writing the slaves. Cyclic exchange can resume at once. The slaves states are kept (Slave::al_status).
+        // Throw an ErrorCode (slaves count or position of the first mismatching slave) if the bus does not match: init()
+        // is required then.
+        void attach(BusConfig const& config, uint8_t* iomap);
+
+        // Blocking exchanges (frames sent together, then their answers read) done by the last init() or attach() call
+        int32_t initRoundTrips() const { return init_round_trips_; }
+
         /// \return the number of slaves detected on the bus
         int32_t detectedSlaves() const;
 
         // request a state for all slaves
         void requestState(State request);
 
+        // Asynchronous state transitions, per slave or per group (Slave::group): requests are written by FPWR and the slaves
+        // states polled by sendStateRequests(), one step per call without waiting. Each slave progresses on its own: a
+        // fast slave reaches its state without waiting the slow ones, and a failing slave does not stall the others.
+        // The result is reported in Slave::state_request.
+        void requestState(Slave& slave, State request, nanoseconds timeout);
+        void requestGroupState(int32_t group, State request, nanoseconds timeout);
+        bool isStateRequestPending() const;
+
         // Get the state a specific slave
         State getCurrentState(Slave& slave);
 
         // wait for all slaves to reached a state
         void waitForState(State request, nanoseconds timeout);
 
+        // State polling starts with a broadcast read of the whole bus AL status: slaves are read one by one only if one
+        // of them reports an error or does not answer
+        void enableStatePrecheck(bool enable) { is_state_precheck_enabled_ = enable; }
+
+        // Configure how slaves PI are placed in the logical image (layout, packing, pinned slaves) - before createMapping()
+        // Note: with bit packing, the client buffer layout is unchanged (each slave PI starts on a byte in the iomap),
+        //       only the frame is packed. Slaves ESC shall support bit oriented FMMU operations.
+        MappingPlanner& mappingPlanner() { return planner_; }
+
+        // Request the PDO mapping of a CoE slave: only the listed objects will be exchanged (smallest PI).
+        // The next mapping creation writes it in PRE_OP - in RxPDO 0x1600 and TxPDO 0x1A00 - and assigns it to the slave
+        // PDO SyncManagers (0x1C1x) before reading the mapping back.
+        void requestPDOMapping(Slave& slave, std::vector<Slave::PDOObject> const& rx_pdo, std::vector<Slave::PDOObject> const& tx_pdo);
+
         // create thje mapping between slaves PI and client buffer
         // if OK, set the bus to SAFE_OP state
         void createMapping(uint8_t* iomap);
 
+        // create the mapping without client buffer: slaves PI live directly in frames memory owned by the link (zero-copy)
+        // - outputs written in Slave::output.data are sent as is by the next sendLogicalWrite() or sendLogicalReadWrite() call
+        // - Slave::input.data is swapped (no copy) to the answer when it is valid: pointer shall be read again after each
+        //   processAwaitingFrames() call, and pointed data stays valid until the next one.
+        // Bit packed mappings point on their first logical byte: use PIMapping::start_bit with readBits()/writeBits().
+        // if OK, set the bus to SAFE_OP state
+        void createZeroCopyMapping();
+
+        // Multi-rate exchange: slaves of a group (Slave::group, in [0, MAX_GROUPS[) get their own PI frames and logical area
+        // - before createMapping() - and are exchanged by the sendDue*() methods at most once per period.
+        // A group without period (default) is due at each call.
+        static constexpr int32_t MAX_GROUPS = 64;
+        void setGroupPeriod(int32_t group, nanoseconds period);
+
+        // Output delta suppression for slow groups (valves, lamps): a LWR datagram of the group frames is sent only when its
+        // outputs changed, or at least every 'max_interval' to keep the slaves SM watchdogs satisfied. 0 (default) sends it
+        // every time. LRW datagrams are always sent (they carry inputs).
+        void setGroupOutputsRefresh(int32_t group, nanoseconds max_interval);
+
+        // Mailboxes states in the process data (before the mapping creation): the SM1 "mailbox full" bit of each mailbox
+        // slave is mapped by a third FMMU in a bit packed logical area, after the PI areas. sendMailboxesChecks() then reads
+        // the whole bus mailboxes state with one LRD datagram of a few bytes - sent in the same frames than the cyclic PI
+        // datagrams - instead of two FPRD per slave (SM0 state is still read for slaves with a message to send).
+        // Slaves ESC shall support bit oriented FMMU operations. Slaves without a third FMMU (ESC or SII FMMUs count) keep
+        // the FPRD checks.
+        void enableMappedMailboxStatus(bool enable) { is_mailbox_status_mapped_ = enable; }
+
+        // Layout used by the last mapping creation, with the predicted cost of a cycle where every group is due
+        MappingPlanner::Plan const& mappingPlan() const { return plan_; }
+
+        // Size of the inputs and outputs parts of the client buffer given to createMapping() (inputs are mapped first)
+        int32_t mappingInputsSize() const;
+        int32_t mappingOutputsSize() const;
+
         std::vector<Slave>& slaves() { return slaves_; }
 
+        // Input change detection: when enabled, each received slave inputs block is compared to the previous one, and
+        // changed slaves are flagged in a bitmap (slaves()[i] is bit i % 64 of word i / 64) until the application clears it.
+        // Event driven consumers only have to touch the flagged slaves.
+        void enableInputChanges(bool enable);
+        std::vector<uint64_t> const& inputChanges() const { return input_changes_; }
+        bool isInputChanged(Slave const& slave) const;
+        void clearInputChanges();
+
+        // Resolve a mapped PDO entry of a slave (after the mapping creation) by object index/subindex or by SII name.
+        // Throw if the entry is not mapped. The handle stays valid until the next mapping creation.
+        Signal findSignal(Slave& slave, uint16_t index, uint8_t subindex) const;
+        Signal findSignal(Slave& slave, std::string_view name) const;
+
         // asynchrone read/write/mailbox/state methods
         // It enable users to do one or multiple operations in a row, process something, and process all awaiting frames.
         void sendGetALStatus(Slave& slave, std::function<void()> const& error);
@@ -55,8 +153,12 @@ namespace kickcat
         void sendLogicalRead(std::function<void()> const& error);
         void sendLogicalWrite(std::function<void()> const& error);
         void sendLogicalReadWrite(std::function<void()> const& error);
+        void sendDueLogicalRead(std::function<void()> const& error, nanoseconds now = since_epoch());        // only due groups
+        void sendDueLogicalWrite(std::function<void()> const& error, nanoseconds now = since_epoch());
+        void sendDueLogicalReadWrite(std::function<void()> const& error, nanoseconds now = since_epoch());
         void sendMailboxesChecks(std::function<void()> const& error);   // Fetch in/out mailboxes states (full/empty) of compatible slaves
         void sendNop(std::function<void()> const& error);               // Send a NOP datagram
+        void sendStateRequests(std::function<void()> const& error, nanoseconds now = since_epoch()); // Advance state requests
         void processAwaitingFrames();
 
         // Process messages (read or write slave mailbox) - one at once per slave.
@@ -84,6 +186,33 @@ namespace kickcat
         void readSDO (Slave& slave, uint16_t index, uint8_t subindex, Access CA, void* data, uint32_t* data_size, nanoseconds timeout = 1s);
         void writeSDO(Slave& slave, uint16_t index, uint8_t subindex, bool CA,   void* data, uint32_t  data_size, nanoseconds timeout = 1s);
 
+        // Non blocking SDO: the request is queued in the slave mailbox and returns at once. The messages are exchanged by
+        // the mailbox datagrams (sendReadMessages(), sendWriteMessages() and sendMailboxesChecks(), i.e. from the cyclic
+        // loop) and processSDORequests() finishes the requests: callback called once, with the final status.
+        // Any number of requests can run on the whole bus, the messages of a slave are sent one after the other.
+        struct SDORequest
+        {
+            Slave* slave;
+            uint16_t index;
+            uint8_t subindex;
+            std::vector<uint8_t> data;      // written value, or read value (resized to the answer size)
+            uint32_t size;
+            nanoseconds since;              // request time
+            nanoseconds deadline;
+            std::function<void(SDORequest const&)> callback;
+            std::shared_ptr<AbstractMessage> message;
+
+            uint32_t status() const { return message->status(); }  // MessageStatus or SDO abort code
+            bool isDone() const     { return status() != MessageStatus::RUNNING; }
+        };
+        using SDOCallback = std::function<void(SDORequest const&)>;
+        std::shared_ptr<SDORequest const> asyncReadSDO (Slave& slave, uint16_t index, uint8_t subindex, uint32_t capacity,
+                                                        nanoseconds timeout, SDOCallback callback = nullptr);
+        std::shared_ptr<SDORequest const> asyncWriteSDO(Slave& slave, uint16_t index, uint8_t subindex, void const* data, uint32_t data_size,
+                                                        nanoseconds timeout, SDOCallback callback = nullptr);
+        void processSDORequests(nanoseconds now = since_epoch());   // finish answered or expired requests
+        bool isSDORequestPending() const { return not sdo_requests_.empty(); }
+
         void clearErrorCounters();
 
 
@@ -103,26 +232,81 @@ namespace kickcat
 
         // INIT state methods
         void detectSlaves();
-        void resetSlaves();
-        void setAddresses();
-        void configureMailboxes();
+        void cancelSDORequests();   // pending SDO requests are finished as timed out
+        bool isStateReached(State request);     // all slaves in the requested state (one polling round)
+        static State decodeState(Slave const& slave);
+        void resetBus();    // init: slaves detected, reset, addressed and in INIT
+        void enterPreOp();  // init: mailboxes configured, slaves in PRE_OP
+        void setupMailboxes();  // clear the mailboxes and register the CoE emergency reception
+        void applyConfig(Slave& slave, SlaveConfig const& config, std::size_t position);  // throw ErrorCode(position)
+        // init datagrams are queued, to be sent together (as few frames as possible) by the caller
+        void sendResetSlaves();
+        void sendAddresses();
+        void sendMailboxesConfiguration();
+        void sendRequestState(State request);
 
         // mapping helpers
+        static constexpr uint64_t ALL_GROUPS = UINT64_MAX;
+        void sendLogicalRead(std::function<void()> const& error, uint64_t groups);       // groups: bitmask of groups to exchange
+        void sendLogicalWrite(std::function<void()> const& error, uint64_t groups, nanoseconds now);
+        void sendLogicalReadWrite(std::function<void()> const& error, uint64_t groups);
         void detectMapping();
+        void fetchFMMUsCount();     // ESC FMMUs count of the mailbox slaves
+        void buildPIFrames();
         void readMappedPDO(Slave& slave, uint16_t index);
+        struct SDOChain;
+        static void writePDOMapping(SDOChain& chain, uint16_t assignment, uint16_t pdo, std::vector<Slave::PDOObject> const& objects);
+        void mapClientBuffer(uint8_t* iomap);
+
+        // SyncManager and FMMU of a mapping - programmed by configureFMMUs(), checked by attach()
+        struct PIConfig
+        {
+            uint16_t sm_address;    // register
+            SyncManager sm;
+            uint16_t fmmu_address;  // register
+            FMMU fmmu;
+        };
+        static PIConfig generatePIConfig(Slave const& slave, Slave::PIMapping const& mapping, SyncManagerType type);
+        static constexpr uint16_t MAILBOX_STATUS_FMMU = reg::FMMU + 0x20;  // FMMU2
+        FMMU generateMailboxStatusFMMU(int32_t bit) const;
         void configureFMMUs();
+        Signal findSignal(Slave& slave, std::function<bool(Slave::PIEntry const&)> const& match) const;
 
         // Slave SII eeprom helpers
-        void fetchEeprom();
-        bool areEepromReady();
-        void readEeprom(uint16_t address, std::vector<Slave*> const& slaves, std::function<void(Slave&, uint32_t word)> apply);
+        void fetchEeprom(bool is_identity_only = false);
 
         // mailbox helpers
         void waitForMessage(std::shared_ptr<AbstractMessage> message, nanoseconds timeout);
 
+        // Concurrent mailbox transactions: one chain of SDO steps per slave. Every chain progresses on each mailbox
+        // round: slaves mailboxes are busy at the same time and share the mailbox frames.
+        struct SDOChain
+        {
+            using Step = std::function<void(SDOChain&)>;
+
+            Slave* slave;
+            std::deque<Step> steps;                 // run in order when no message is pending
+            std::vector<Step> scheduled;            // steps added by the running step: inserted before the remaining ones
+            std::shared_ptr<AbstractMessage> pending;
+            std::function<void()> on_done;          // called once the pending message is finished
+            nanoseconds since{0};                   // pending message start time
+            uint16_t index{0};                      // pending message object (tracing)
+            uint8_t subindex{0};
+
+            void then(Step step) { scheduled.push_back(std::move(step)); }
+            void wait(std::shared_ptr<AbstractMessage> message, uint16_t object_index, uint8_t object_subindex, std::function<void()> done);
+            void flush();
+        };
+        void processSDOChains(std::vector<SDOChain>& chains, nanoseconds timeout);
+        static void chainReadSDO(SDOChain& chain, uint16_t index, void* data, uint32_t capacity,   // emulated complete access
+                                 std::function<void(SDOChain&, uint32_t size)> on_done);
+        static void chainWriteSDO(SDOChain& chain, uint16_t index, uint8_t subindex, uint32_t value, uint32_t size);
+
         Link link_;
         std::vector<Slave> slaves_;
 
+        bool is_zero_copy_{false};      // PI lives in the link frames
+
         uint8_t* iomap_read_section_;   // pointer on read section (to write back inputs)
         uint8_t* iomap_write_section_;  // pointer on write section (to send to the slaves)
 
@@ -132,16 +316,69 @@ namespace kickcat
             uint32_t offset;    // frame offset
             int32_t  size;      // block size
             Slave*   slave;     // associated slave of this input
+            uint8_t  bit_offset;// start bit in the frame byte (bit packed block only)
+            uint8_t  bit_size;  // size in bits if the block is bit packed, 0 otherwise
+            int32_t  index;     // index of the slave on the bus
         };
 
         struct PIFrame
         {
             uint32_t address;               // logical address
             int32_t size;                   // frame size
+            int32_t group;                  // slaves group exchanged by this frame
             std::vector<blockIO> inputs;    // slave to master
             std::vector<blockIO> outputs;
+            ZeroCopyFrame* zero_copy;       // frame holding the PI in zero-copy mode, nullptr otherwise
+            uint64_t* input_changes;        // changed slaves bitmap, nullptr if change detection is disabled
+
+            // copy plan: blocks contiguous in the frame and in the client buffer merged in one copy (slave is the first one)
+            std::vector<blockIO> input_runs;
+            std::vector<blockIO> output_runs;
+
+            // output delta suppression: last sent outputs (frame layout) and time
+            std::vector<uint8_t> sent_outputs;
+            nanoseconds last_write{0};
+
+            // expected working counters: each slave increments it by one on read and by two on write
+            uint16_t expectedReadWKC()      const { return inputs.size(); }
+            uint16_t expectedWriteWKC()     const { return outputs.size(); }
+            uint16_t expectedReadWriteWKC() const { return inputs.size() + 2 * outputs.size(); }
+        };
+        // PI frame description - built once by the mapping creation, then only referenced by the cyclic datagrams
+        // callbacks: exchanging the PI shall not copy it nor allocate memory.
+        std::vector<PIFrame> pi_frames_;
+        MappingPlanner planner_;
+
+        struct PIGroup
+        {
+            nanoseconds period{0};
+            nanoseconds next_read{0};   // next due time of the inputs
+            nanoseconds next_write{0};  // next due time of the outputs
+            nanoseconds refresh{0};     // outputs delta suppression: forced refresh interval, 0 if disabled
         };
-        std::vector<PIFrame> pi_frames_; // PI frame description
+        std::vector<PIGroup> groups_;
+        MappingPlanner::Plan plan_{};
+
+        bool is_mailbox_status_mapped_{false};
+        uint32_t mailbox_status_address_{0};        // logical address of the mapped mailboxes status area
+        std::vector<Slave*> mailbox_status_slaves_; // slave of each bit of this area, empty if not mapped
+
+        bool is_input_changes_enabled_{false};
+        std::vector<uint64_t> input_changes_;
+        void setupInputChanges();
+
+        // PI helpers
+        static std::vector<blockIO> buildCopyRuns(std::vector<blockIO> const& blocks);
+        static void readInputs(PIFrame const& pi_frame, uint8_t const* data);   // frame to client buffer
+        static void detectInputChanges(PIFrame const& pi_frame, uint8_t const* data);
+        static void writeOutputs(PIFrame const& pi_frame, uint8_t* data);       // client buffer to frame
+        static bool updateSentOutputs(PIFrame& pi_frame);                       // \return true if outputs changed since the last call
+
+        SIICache sii_cache_;
+        bool is_state_precheck_enabled_{false};
+        int32_t init_round_trips_{0};
+        Tracer* tracer_{nullptr};
+        std::vector<std::shared_ptr<SDORequest>> sdo_requests_;
 
         nanoseconds tiny_wait{200us};
         nanoseconds big_wait{10ms};
@@ -0,0 +1,77 @@
+#ifndef KICKCAT_BUS_CONFIG_H
+#define KICKCAT_BUS_CONFIG_H
+
+#include <string>
+#include <vector>
+
+#include "Slave.h"
+
+namespace kickcat
+{
+    /// \brief Expected configuration of one slave
+    struct SlaveConfig
+    {
+        uint32_t vendor_id;
+        uint32_t product_code;
+        uint32_t revision_number;
+        uint32_t serial_number;
+
+        uint16_t recv_offset;       // standard mailbox
+        uint16_t recv_size;
+        uint16_t send_offset;
+        uint16_t send_size;
+        uint16_t supported_mailbox; // eeprom::MailboxProtocol bitmask
+
+        std::vector<eeprom::SyncManagerEntry> sync_managers;
+
+        struct Entry
+        {
+            uint16_t index;
+            uint8_t  subindex;
+            uint8_t  bit_size;
+        };
+        struct Mapping
+        {
+            int32_t size;           // in bits
+            int32_t sync_manager;
+            std::vector<Entry> entries;
+        };
+        Mapping input;
+        Mapping output;
+
+        // Startup SDO, written in PRE_OP in the listed order (i.e. PDO remapping)
+        struct SDO
+        {
+            uint16_t index;
+            uint8_t  subindex;
+            uint32_t size;          // in bytes, up to 4
+            uint32_t value;
+        };
+        std::vector<SDO> sdos;
+
+        // SDO sequence of a PDO remapping (ETG 1000.6): disable, write the entries, enable
+        static std::vector<SDO> remapSDOs(uint16_t assignment, uint16_t pdo, std::vector<Slave::PDOObject> const& objects);
+    };
+
+    /// \brief Expected bus configuration, to bring the bus up without discovery: see Bus::init(BusConfig const&)
+    /// \details Text file, one item per line ('#' starts a comment), numbers in decimal or 0x prefixed hexadecimal.
+    ///          Slaves are listed in bus order, every item after a 'slave' line belongs to this slave:
+    ///          slave   <vendor id> <product code> <revision number> <serial number>
+    ///          mailbox <recv offset> <recv size> <send offset> <send size> <supported protocols>
+    ///          sm      <start address> <length> <control> <status> <enable> <type>
+    ///          input   <bit size> <sync manager>                (same for output)
+    ///          entry   input|output <index> <subindex> <bit size>
+    ///          sdo     <index> <subindex> <size> <value>
+    struct BusConfig
+    {
+        std::vector<SlaveConfig> slaves;
+
+        static BusConfig load(std::string const& path);
+        void save(std::string const& path) const;
+
+        // Describe a discovered bus, after the mapping creation. A requested PDO mapping is saved as startup SDOs.
+        static BusConfig fromSlaves(std::vector<Slave> const& slaves);
+    };
+}
+
+#endif
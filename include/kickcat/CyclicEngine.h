@@ -0,0 +1,111 @@
+#ifndef KICKCAT_CYCLIC_ENGINE_H
+#define KICKCAT_CYCLIC_ENGINE_H
+
+#include <atomic>
+#include <functional>
+
+#include "Bus.h"
+#include "Time.h"
+
+namespace kickcat
+{
+    /// \brief Drive the bus cyclic exchange on absolute deadlines of the monotonic clock
+    /// \details Each cycle: wait for the deadline, call the pre-send hook, send the PI (due groups), process the answers
+    ///          and call the post-receive hook. The period does not drift with the cycle duration.
+    ///          - pre-send hook: compute the outputs, queue others datagrams (mailboxes, error counters...)
+    ///          - post-receive hook: consume the inputs
+    ///          Slaves state requests (Bus::requestState(Slave&, ...)) are advanced at each cycle, after the pre-send hook.
+    ///          With the mailboxes service, the mailboxes are read, written and checked at each cycle too, and the
+    ///          asynchronous SDO requests (Bus::asyncReadSDO(), ...) are finished before the post-receive hook.
+    ///          A cycle ending after the next deadline is an overrun: missed deadlines are skipped (no burst to catch up).
+    ///          A wake-up later than the configured threshold is a late wake-up. Both are counted and timestamped.
+    ///
+    ///          Pipelined mode: inputs are read (LRD) at the deadline, and the outputs computed from them by the post-receive
+    ///          hook are written (LWR) right away - or at the configured phase offset from the deadline - instead of waiting
+    ///          the next cycle. The LWR answer is processed with the next inputs: output emission and input reception overlap.
+    class CyclicEngine
+    {
+    public:
+        struct Statistics
+        {
+            int64_t cycles{0};
+            int64_t errors{0};                  // datagrams errors (i.e. invalid working counter, lost frame)
+            int64_t overruns{0};
+            int64_t late_wakeups{0};
+            nanoseconds last_overrun{0};        // monotonic time of the last overrun (end of the cycle)
+            nanoseconds last_late_wakeup{0};    // monotonic time of the last late wake-up
+            nanoseconds max_wakeup_latency{0};  // wake-up time - deadline
+            nanoseconds max_cycle_time{0};      // end of the cycle - deadline
+            nanoseconds max_io_latency{0};      // see Timestamps::latency()
+        };
+
+        // Timestamps (monotonic time) of the last cycle whose outputs are sent
+        struct Timestamps
+        {
+            nanoseconds deadline{0};
+            nanoseconds wakeup{0};
+            nanoseconds inputs{0};      // inputs received
+            nanoseconds outputs{0};     // outputs computed from these inputs sent
+
+            nanoseconds latency() const { return outputs - inputs; }   // input to output latency
+        };
+
+        CyclicEngine(Bus& bus, nanoseconds period);
+        ~CyclicEngine() = default;
+
+        void setPreSend(std::function<void()> hook)     { pre_send_ = std::move(hook); }
+        void setPostReceive(std::function<void()> hook) { post_receive_ = std::move(hook); }
+
+        // A wake-up later than the threshold after its deadline is reported as late (default: 10% of the period)
+        void setLateWakeupThreshold(nanoseconds threshold) { late_threshold_ = threshold; }
+
+        // Real time setup of the calling thread, applied by run(): SCHED_FIFO priority (0: keep the current scheduler)
+        // and CPU affinity (-1: keep the current one)
+        void setRealTime(int32_t priority, int32_t cpu = -1);
+
+        // Exchange the mailboxes messages at each cycle (do not queue mailboxes datagrams from the hooks then)
+        void enableMailboxes(bool enable) { is_mailboxes_enabled_ = enable; }
+
+        // Enable the pipelined mode: outputs are sent 'phase' after the deadline, or as soon as computed if it is later
+        void setPipelined(bool enable, nanoseconds phase = 0ns);
+
+        /// \brief Run cycles until stop() is called or 'cycles' cycles are done (-1: no limit)
+        /// \details Real time setup failure or bus exceptions are thrown to the caller.
+        void run(int64_t cycles = -1);
+        void stop() { is_running_ = false; }  // thread safe, from a hook or another thread
+
+        nanoseconds period() const { return period_; }
+        nanoseconds cycleStart() const { return deadline_; }   // deadline of the current cycle (monotonic time)
+        Statistics const& statistics() const { return stats_; }
+        Timestamps const& timestamps() const { return timestamps_; }
+        void resetStatistics() { stats_ = Statistics{}; }
+
+    private:
+        void setupRealTime();
+        void cycle();
+        void outputsSent(Timestamps const& inputs_cycle);
+        void sendMailboxes();
+        void receiveMailboxes();
+
+        Bus& bus_;
+        nanoseconds period_;
+        nanoseconds late_threshold_;
+        nanoseconds deadline_{0};
+        int32_t priority_{0};
+        int32_t cpu_{-1};
+        bool is_pipelined_{false};
+        bool is_mailboxes_enabled_{false};
+        nanoseconds phase_{0};
+
+        std::function<void()> pre_send_;
+        std::function<void()> post_receive_;
+        std::function<void()> error_;
+
+        std::atomic<bool> is_running_{false};
+        Statistics stats_;
+        Timestamps timestamps_;
+        Timestamps pending_;        // classic mode: cycle whose inputs are sent with the next outputs
+    };
+}
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef KICKCAT_ERROR_H
 #define KICKCAT_ERROR_H
 
+#include <cstdint>
 #include <exception>
 #include <system_error>
 
@@ -50,6 +51,23 @@ namespace kickcat
     private:
         int32_t code_;
     };
+
+    // SDO refused by a slave: the code is the SDO abort code
+    struct SDOError : public ErrorCode
+    {
+        SDOError(char const* message, int32_t code, uint16_t index, uint8_t subindex)
+            : ErrorCode(message, code)
+            , index_{index}
+            , subindex_{subindex}
+        { }
+
+        uint16_t index() const noexcept    { return index_; }
+        uint8_t  subindex() const noexcept { return subindex_; }
+
+    private:
+        uint16_t index_;
+        uint8_t  subindex_;
+    };
 }
 
 #endif
@@ -51,8 +51,8 @@ namespace kickcat
         bool isDatagramAvailable() const { return is_datagram_available_; }
 
         // handle bus access
-        void read(std::shared_ptr<AbstractSocket> socket);
-        void write(std::shared_ptr<AbstractSocket> socket);
+        void read(std::shared_ptr<AbstractSocket> const& socket);
+        void write(std::shared_ptr<AbstractSocket> const& socket);
 
         // helper to access raw frame (mostly for unit testing)
         uint8_t* data() { return frame_.data(); }
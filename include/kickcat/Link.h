@@ -3,14 +3,57 @@
 
 #include <array>
 #include <memory>
+#include <vector>
 #include <functional>
 
 #include "Frame.h"
+#include "Tracer.h"
 
 namespace kickcat
 {
     class AbstractSocket;
 
+    /// \brief Frame dedicated to one cyclic datagram, for zero-copy process data exchange
+    /// \details The datagram is prepared once and its payload is the process image itself:
+    ///          - the emission buffer is written on the wire as is: the application writes its outputs in place,
+    ///          - answers are read in a back buffer which is swapped with the front one once validated (double buffering):
+    ///            the front buffer holds the last valid inputs.
+    class ZeroCopyFrame
+    {
+    public:
+        ZeroCopyFrame(uint32_t address, uint16_t data_size);
+        ~ZeroCopyFrame() = default;
+
+        uint32_t address() const   { return address_;   }
+        uint16_t dataSize() const  { return data_size_; }
+
+        /// \return emission datagram payload (outputs)
+        uint8_t* payload() { return tx_.data() + PAYLOAD_OFFSET; }
+
+        /// \return last validated answer payload (inputs)
+        uint8_t* front() { return rx_[front_].data() + PAYLOAD_OFFSET; }
+
+        /// \return answer payload validated before the front one (previous inputs) - valid until the next answer reception
+        uint8_t const* previous() { return back().data() + PAYLOAD_OFFSET; }
+
+        /// \brief Validate an answer: it becomes the front buffer
+        /// \param data answer payload - copied in the back buffer only if the answer was not read in it (i.e. a previous frame was lost)
+        void swap(uint8_t const* data);
+
+    private:
+        friend class Link;
+        static constexpr int32_t PAYLOAD_OFFSET = sizeof(EthernetHeader) + sizeof(EthercatHeader) + sizeof(DatagramHeader);
+
+        Frame& back() { return rx_[1 - front_]; }
+
+        uint32_t address_;
+        uint16_t data_size_;
+        EthernetFrame tx_;
+        int32_t tx_size_;
+        Frame rx_[2];
+        int32_t front_{0};
+    };
+
     /// \brief Handle link layer
     /// \details This class is responsible to handle frames and datagrams on the link layers:
     ///           - associate an id to each datagram to call the associate callback later without depending on the read order
@@ -35,9 +78,26 @@ namespace kickcat
             addDatagram(command, address, &data, sizeof(data), process, error);
         }
 
+        /// \brief Send a zero-copy frame (the datagram payload is sent as is) - its answer will be read in the frame back buffer
+        void addDatagram(ZeroCopyFrame& frame, enum Command command,
+                         std::function<bool(DatagramHeader const*, uint8_t const* data, uint16_t wkc)> const& process,
+                         std::function<void()> const& error);
+
         void finalizeDatagrams();
         void processDatagrams();
 
+        /// \brief Record each frame, from its emission to its answer reception (nullptr: disabled)
+        void setTracer(Tracer* tracer) { tracer_ = tracer; }
+
+        /// \brief Exchange statistics: frames sent, and round trips (blocking exchanges: writeThenRead() or processDatagrams()
+        ///        calls that sent frames - the frames of a round trip are in flight together)
+        int64_t sentFrames() const { return sent_frames_; }
+        int64_t roundTrips() const { return round_trips_; }
+
+        /// \brief Create a zero-copy frame owned by the link. Reference is valid until releaseZeroCopyFrames() call.
+        ZeroCopyFrame& createZeroCopyFrame(uint32_t address, uint16_t data_size);
+        void releaseZeroCopyFrames();
+
     private:
         void sendFrame();
 
@@ -46,6 +106,11 @@ namespace kickcat
         uint8_t index_head_{0};
         uint8_t sent_frame_{0};
         Frame frame_{PRIMARY_IF_MAC};
+        int64_t sent_frames_{0};
+        int64_t round_trips_{0};
+
+        Tracer* tracer_{nullptr};
+        std::array<nanoseconds, 256> sent_at_{};                    // emission time of each sent frame (tracing)
 
         struct Callbacks
         {
@@ -54,6 +119,9 @@ namespace kickcat
             std::function<void()> error;
         };
         std::array<Callbacks, 256> callbacks_{};
+
+        std::array<ZeroCopyFrame*, 256> destinations_{};           // where to read the answer of each sent frame (nullptr: frame_)
+        std::vector<std::unique_ptr<ZeroCopyFrame>> zero_copy_frames_;
     };
 }
 
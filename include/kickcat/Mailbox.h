@@ -21,6 +21,7 @@ namespace kickcat
     {
         constexpr uint32_t SUCCESS                      = 0x000;
         constexpr uint32_t RUNNING                      = 0x001;
+        constexpr uint32_t TIMEDOUT                     = 0x002;    // no answer in time: the message was cancelled
 
         constexpr uint32_t COE_WRONG_SERVICE            = 0x101;
         constexpr uint32_t COE_UNKNOWN_SERVICE          = 0x102;
@@ -51,6 +52,8 @@ namespace kickcat
         size_t size() const         { return data_.size(); }
 
     protected:
+        friend struct Mailbox;          // cancel()
+
         std::vector<uint8_t> data_;     // data of the message (send only)
         mailbox::Header* header_;       // pointer on the mailbox header in data
         uint32_t status_;               // message current status
@@ -78,6 +81,9 @@ namespace kickcat
         std::shared_ptr<AbstractMessage> send();
 
         bool receive(uint8_t const* raw_message);
+
+        // stop a running message: it is removed from the queues with the given final status (a late answer is ignored)
+        void cancel(std::shared_ptr<AbstractMessage> const& message, uint32_t status);
         std::queue<std::shared_ptr<AbstractMessage>> to_send;     // message waiting to be sent
         std::list <std::shared_ptr<AbstractMessage>> to_process;  // message already sent, waiting for an answer
 
@@ -0,0 +1,121 @@
+#ifndef KICKCAT_MAPPING_PLANNER_H
+#define KICKCAT_MAPPING_PLANNER_H
+
+#include <vector>
+#include <unordered_map>
+
+#include "protocol.h"
+#include "Time.h"
+
+namespace kickcat
+{
+    /// \brief Compute the process image layout from the slaves PI sizes
+    /// \details The planner chooses the logical address of each slave input and output and split them in PI frames
+    ///          (one logical datagram per PI frame) to minimize the frames and the bytes sent on the wire per cycle.
+    class MappingPlanner
+    {
+    public:
+        enum Layout
+        {
+            AUTO       = 0, // choose the layout with the lowest predicted wire time
+            OVERLAPPED = 1, // inputs and outputs of a slave share the same logical area (LRW friendly)
+            SEPARATED  = 2  // inputs and outputs are placed in two distinct areas (LRD + LWR friendly)
+        };
+
+        enum Packing
+        {
+            BYTE_ALIGNED = 0,   // every slave PI starts on a byte boundary
+            BIT_PACKED   = 1    // slaves with less than 8 bits of PI share bytes through FMMU bit offsets
+        };
+
+        enum Exchange
+        {
+            READ_WRITE      = 0, // one LRW per PI frame (i.e. Bus::processDataReadWrite())
+            READ_THEN_WRITE = 1  // one LRD and one LWR per PI frame (i.e. Bus::processDataRead() + Bus::processDataWrite())
+        };
+
+        struct Entry                // slave PI sizes
+        {
+            int32_t input_size;     // in bits
+            int32_t output_size;    // in bits
+        };
+
+        struct Area                 // where a slave PI is placed
+        {
+            int32_t  frame;         // PI frame index, -1 if there is nothing to map
+            uint32_t address;       // logical address
+            uint8_t  start_bit;     // start bit in the first byte
+            bool     is_bit_packed; // the area shares its byte with others areas
+        };
+
+        struct PIFrame
+        {
+            uint32_t address;       // logical address
+            int32_t  size;          // in bytes
+            int32_t  inputs;        // number of slave input areas in the frame
+            int32_t  outputs;       // number of slave output areas in the frame
+        };
+
+        struct Plan
+        {
+            Layout layout;
+            std::vector<Area> inputs;       // one per slave
+            std::vector<Area> outputs;      // one per slave
+            std::vector<PIFrame> frames;
+
+            // predicted cost of one cycle for the configured exchange
+            int32_t datagrams;              // logical datagrams
+            int32_t ethernet_frames;
+            int32_t wire_bytes;             // including Ethernet preamble, FCS and inter frame gap
+            nanoseconds wire_time;          // at 100 Mbit/s
+        };
+
+        void setLayout(Layout layout)       { layout_ = layout;     }
+        void setPacking(Packing packing)    { packing_ = packing;   }
+        void setExchange(Exchange exchange) { exchange_ = exchange; }
+        Packing packing() const             { return packing_;      }
+
+        /// \brief Force a slave PI in a specific PI frame (with SEPARATED layout, in the frame of each area)
+        /// \details Slaves pinned on the same frame are exchanged together. The pinned frame is an index before compaction:
+        ///          frames left empty are dropped from the plan, so the plan frame index of a pinned slave may be lower
+        ///          (e.g. a single slave pinned on frame 3 ends in frame 0). The plan frames keep the pins order and are
+        ///          numbered in logical address order.
+        void pin(int32_t slave, int32_t frame) { pins_[slave] = frame; }
+        void clearPins()                       { pins_.clear(); }
+
+        /// \return the layout for the given slaves. Throw if pinned slaves do not fit in their frame.
+        Plan plan(std::vector<Entry> const& slaves) const;
+
+    private:
+        struct Item
+        {
+            int32_t slave;
+            int32_t bits;
+        };
+
+        struct Bin
+        {
+            int32_t bytes{0};   // bytes used (a partially used byte counts)
+            int32_t bit{0};     // bits used in the last byte by bit packed items (0 if the byte is full or not shared)
+        };
+
+        bool isBitPacked(int32_t bits) const;
+        bool fit(Bin const& bin, int32_t bits) const;
+        Area place(Bin& bin, int32_t bin_index, int32_t bits) const;
+
+        // pack items in bins: return the area of each item (indexed by slave)
+        std::vector<Bin> pack(std::vector<Item> const& items, bool decreasing_order, std::vector<Area>& areas) const;
+        std::vector<Bin> packBest(std::vector<Item> const& items, std::vector<Area>& areas) const;
+
+        Plan planOverlapped(std::vector<Entry> const& slaves) const;
+        Plan planSeparated (std::vector<Entry> const& slaves) const;
+        void evaluate(Plan& plan) const;
+
+        Layout   layout_{AUTO};
+        Packing  packing_{BYTE_ALIGNED};
+        Exchange exchange_{READ_WRITE};
+        std::unordered_map<int32_t, int32_t> pins_;
+    };
+}
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef KICKCAT_PDO_LAYOUT_H
+#define KICKCAT_PDO_LAYOUT_H
+
+#include <array>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "Bits.h"
+#include "Error.h"
+#include "Slave.h"
+
+namespace kickcat
+{
+    /// \brief One PDO entry of a typed layout: 'BITS' bits read and written as a 'T'
+    /// \details Fields narrower than their type shall be unsigned (no sign extension).
+    template<typename T, int32_t BITS = sizeof(T) * 8>
+    struct Field
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "Field type shall be trivially copyable");
+        static_assert((BITS > 0) and (BITS <= static_cast<int32_t>(sizeof(T) * 8)), "Field bits shall fit in its type");
+        static_assert(std::is_unsigned_v<T> or (BITS == sizeof(T) * 8), "Partial fields shall be unsigned");
+
+        using type = T;
+        static constexpr int32_t bits = BITS;
+    };
+
+    /// \brief Unused bits of a PDO (padding entry)
+    template<int32_t BITS>
+    using Gap = Field<uint64_t, BITS>;
+
+
+    /// \brief Typed PDO layout: fields are packed LSB first in declaration order, as in the slave mapping.
+    /// \details Offsets are computed at compile time: an accessor is a plain load or a fixed shift and mask.
+    ///          Check the layout once against the detected mapping, then access the PI without any check.
+    ///
+    ///          using Inputs = PDOLayout<Field<uint16_t>, Field<int32_t>, Field<uint8_t, 4>, Gap<4>>;
+    ///          Inputs::check(slave.input);
+    ///          int32_t position = Inputs::get<1>(slave.input.data);
+    template<typename... Fields>
+    class PDOLayout
+    {
+    public:
+        static constexpr int32_t FIELDS = sizeof...(Fields);
+        static constexpr int32_t bits   = (Fields::bits + ... + 0);
+        static constexpr int32_t bytes  = (bits + 7) / 8;
+
+        template<int32_t I>
+        using type = typename std::tuple_element_t<I, std::tuple<Fields...>>::type;
+
+        /// \return offset in bits of field I
+        template<int32_t I>
+        static constexpr int32_t offset()
+        {
+            static_assert(I < FIELDS, "Invalid field");
+            constexpr std::array<int32_t, FIELDS> sizes{Fields::bits...};
+            int32_t result = 0;
+            for (int32_t i = 0; i < I; ++i)
+            {
+                result += sizes[i];
+            }
+            return result;
+        }
+
+        /// \return size in bits of field I
+        template<int32_t I>
+        static constexpr int32_t size()
+        {
+            return std::tuple_element_t<I, std::tuple<Fields...>>::bits;
+        }
+
+        template<int32_t I>
+        static type<I> get(uint8_t const* data)
+        {
+            type<I> value;
+            if constexpr (isAligned<I>())
+            {
+                std::memcpy(&value, data + offset<I>() / 8, sizeof(value));
+            }
+            else
+            {
+                uint64_t raw = readBits(data, offset<I>(), size<I>());
+                std::memcpy(&value, &raw, sizeof(value)); // little endian: lower bytes of raw
+            }
+            return value;
+        }
+
+        template<int32_t I>
+        static void set(uint8_t* data, type<I> value)
+        {
+            if constexpr (isAligned<I>())
+            {
+                std::memcpy(data + offset<I>() / 8, &value, sizeof(value));
+            }
+            else
+            {
+                uint64_t raw = 0;
+                std::memcpy(&raw, &value, sizeof(value));
+                writeBits(data, offset<I>(), size<I>(), raw);
+            }
+        }
+
+        /// \brief Check the layout against the mapping detected by Bus::createMapping(). Throw if the size differs.
+        static void check(Slave::PIMapping const& mapping)
+        {
+            if (mapping.size != bits)
+            {
+                THROW_ERROR("PDO layout does not match the slave mapping size");
+            }
+        }
+
+        /// \brief Check the layout field by field against SII PDO entries (Slave::SII::TxPDO or Slave::SII::RxPDO).
+        static void check(std::vector<eeprom::PDOEntry const*> const& entries)
+        {
+            constexpr std::array<int32_t, FIELDS> sizes{Fields::bits...};
+            if (entries.size() != FIELDS)
+            {
+                THROW_ERROR("PDO layout does not match the slave PDO entries number");
+            }
+
+            for (int32_t i = 0; i < FIELDS; ++i)
+            {
+                if (entries[i]->bitlen != sizes[i])
+                {
+                    THROW_ERROR("PDO layout does not match the slave PDO entry size");
+                }
+            }
+        }
+
+    private:
+        template<int32_t I>
+        static constexpr bool isAligned()
+        {
+            return ((offset<I>() % 8) == 0) and (size<I>() == static_cast<int32_t>(sizeof(type<I>) * 8));
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef KICKCAT_SII_CACHE_H
+#define KICKCAT_SII_CACHE_H
+
+#include <string>
+
+#include "Slave.h"
+
+namespace kickcat
+{
+    /// \brief On-disk cache of the slaves SII categories (Slave::sii.buffer)
+    /// \details One file per slave identity: vendor id, product code, revision number, serial number and the ESC
+    ///          configuration area checksum (SII word 7). Only these words are read on the bus for a known slave.
+    ///          The categories themselves are not covered by the checksum: remove the cache entry of a slave whose
+    ///          SII is rewritten without an identity change.
+    class SIICache
+    {
+    public:
+        SIICache() = default;                   // disabled
+        SIICache(std::string const& directory); // the directory shall exist
+
+        bool isEnabled() const { return not directory_.empty(); }
+
+        // Load the slave SII categories. \return false if the slave identity is not in the cache (or the entry is invalid)
+        bool load(Slave& slave) const;
+
+        // Store the slave SII categories. Failures are only reported: the cache is an optimization.
+        void store(Slave const& slave) const;
+
+        // Cache entry of the slave identity
+        std::string path(Slave const& slave) const;
+
+    private:
+        std::string directory_;
+    };
+}
+
+#endif
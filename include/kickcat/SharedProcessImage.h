@@ -0,0 +1,87 @@
+#ifndef KICKCAT_SHARED_PROCESS_IMAGE_H
+#define KICKCAT_SHARED_PROCESS_IMAGE_H
+
+#include <atomic>
+#include <vector>
+
+#include "Slave.h"
+
+namespace kickcat
+{
+    /// \brief Lock-free triple buffer: one producer thread publishes complete buffers, one consumer thread acquires the latest one.
+    /// \details Producer and consumer each own a buffer, the third one is exchanged through an atomic index: nobody waits
+    ///          and the consumer never sees a partially written buffer.
+    class TripleBuffer
+    {
+    public:
+        TripleBuffer(int32_t size);
+        ~TripleBuffer() = default;
+
+        int32_t size() const { return size_; }
+
+        // producer side
+        uint8_t* writeBuffer() { return buffer(write_); }
+        void publish();
+
+        // consumer side
+        /// \return true if a new buffer was published since the last call (readBuffer() changed)
+        bool acquire();
+        uint8_t const* readBuffer() const { return buffer(read_); }
+
+    private:
+        static constexpr uint8_t INDEX_MASK = 0x3;
+        static constexpr uint8_t FRESH      = 0x4;  // middle buffer was published and not acquired yet
+        static constexpr int32_t ALIGNMENT  = 64;   // one cache line per buffer: producer and consumer do not share lines
+
+        uint8_t* buffer(uint8_t index)             { return data_.data() + index * stride_; }
+        uint8_t const* buffer(uint8_t index) const { return data_.data() + index * stride_; }
+
+        int32_t size_;
+        int32_t stride_;
+        std::vector<uint8_t> data_;
+
+        uint8_t write_{0};
+        alignas(ALIGNMENT) std::atomic<uint8_t> middle_{1};
+        alignas(ALIGNMENT) uint8_t read_{2};
+    };
+
+
+    /// \brief Process image shared between the cyclic thread and application threads.
+    /// \details Built on top of the client buffer given to Bus::createMapping(): only the cyclic thread touches it.
+    ///          - cyclic thread: acquireOutputs() before sending the PI, publishInputs() once the answer is processed.
+    ///          - one application thread reads the inputs: acquireInputs() then inputs(), a consistent snapshot of one cycle.
+    ///          - one application thread writes the outputs: outputs() then commitOutputs(), sent as a whole at the next cycle.
+    ///          No call blocks, so application threads cannot delay the cyclic thread.
+    class SharedProcessImage
+    {
+    public:
+        /// \param iomap        client buffer given to Bus::createMapping()
+        /// \param inputs_size  Bus::mappingInputsSize()
+        /// \param outputs_size Bus::mappingOutputsSize()
+        SharedProcessImage(uint8_t* iomap, int32_t inputs_size, int32_t outputs_size);
+        ~SharedProcessImage() = default;
+
+        // cyclic thread side
+        void publishInputs();
+        /// \return true if new outputs were copied in the client buffer
+        bool acquireOutputs();
+
+        // inputs reader side
+        /// \return true if the snapshot changed since the last call
+        bool acquireInputs();
+        uint8_t const* inputs() const { return inputs_.readBuffer(); }
+        uint8_t const* inputs(Slave const& slave) const;
+
+        // outputs writer side: the buffer holds the last committed outputs
+        uint8_t* outputs() { return outputs_.writeBuffer(); }
+        uint8_t* outputs(Slave const& slave);
+        void commitOutputs();
+
+    private:
+        uint8_t* iomap_;
+        TripleBuffer inputs_;
+        TripleBuffer outputs_;
+    };
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef KICKCAT_SIGNAL_H
+#define KICKCAT_SIGNAL_H
+
+#include "Bits.h"
+
+namespace kickcat
+{
+    /// \brief Handle on one mapped PDO entry, resolved once with Bus::findSignal()
+    /// \details The handle points on the slave PI pointer (not on the PI itself) to follow zero-copy buffer swaps.
+    struct Signal
+    {
+        uint8_t* const* data;   // Slave::PIMapping::data of the owning mapping
+        int32_t bit_offset;     // from *data
+        int32_t bit_size;       // up to 64
+    };
+
+    inline uint64_t readSignal(Signal const& signal)
+    {
+        return readBits(*signal.data, signal.bit_offset, signal.bit_size);
+    }
+
+    inline void writeSignal(Signal const& signal, uint64_t value)
+    {
+        writeBits(*signal.data, signal.bit_offset, signal.bit_size, value);
+    }
+
+    /// \brief Read 'count' signals in a flat array (i.e. every subscribed signal once per cycle)
+    inline void readSignals(Signal const* signals, int32_t count, uint64_t* values)
+    {
+        for (int32_t i = 0; i < count; ++i)
+        {
+            values[i] = readSignal(signals[i]);
+        }
+    }
+
+    /// \brief Write 'count' signals from a flat array
+    inline void writeSignals(Signal const* signals, int32_t count, uint64_t const* values)
+    {
+        for (int32_t i = 0; i < count; ++i)
+        {
+            writeSignal(signals[i], values[i]);
+        }
+    }
+}
+
+#endif
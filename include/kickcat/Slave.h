@@ -2,10 +2,12 @@
 #define KICKCAT_SLAVE_H
 
 #include <vector>
+#include <string>
 #include <string_view>
 
 #include "protocol.h"
 #include "Mailbox.h"
+#include "Time.h"
 
 namespace kickcat
 {
@@ -29,10 +31,13 @@ namespace kickcat
         Mailbox mailbox;
         Mailbox mailbox_bootstrap;
         eeprom::MailboxProtocol supported_mailbox;
+        uint8_t esc_fmmus{0};                   // FMMUs supported by the ESC, read only to map the mailbox status
+        bool is_mailbox_status_mapped{false};   // SM1 state read through the bus mapped mailboxes status area
         int32_t waiting_datagram; // how many datagram to process for this slave
 
         uint32_t eeprom_size; // in bytes
         uint16_t eeprom_version;
+        uint16_t eeprom_crc;  // ESC configuration area checksum (SII word 7)
 
         struct SII
         {
@@ -49,17 +54,59 @@ namespace kickcat
 
         struct PIMapping
         {
-            uint8_t* data;          // buffer client to read or write back
-            int32_t size;           // size fo the mapping (in bits)
-            int32_t bsize;          // size of the mapping (in bytes)
-            int32_t sync_manager;   // associated Sync manager
-            uint32_t address;       // logical address
+            uint8_t* data{nullptr};     // buffer client to read or write back
+            int32_t size{0};            // size fo the mapping (in bits)
+            int32_t bsize{0};           // size of the mapping (in bytes)
+            int32_t sync_manager{-1};   // associated Sync manager, -1 if none
+            uint32_t address{0};        // logical address
+            uint8_t start_bit{0};       // logical start bit in the first byte (0 if the mapping is not bit packed)
+            bool is_bit_packed{false};  // mapping shares its logical byte with others slaves
         };
         // set it to true to let user define the mapping, false to autodetect it
         // If set to true, user shall set input and output mapping bsize and sync_manager members.
         bool is_static_mapping;
         PIMapping input;            // slave to master
         PIMapping output;
+        int32_t group{0};           // process data group: see Bus::setGroupPeriod()
+
+        struct PIEntry
+        {
+            uint16_t index;
+            uint8_t  subindex;
+            std::string name;       // SII name (a copy: the slave SII may be fetched again), empty if unknown
+            int32_t  bit_offset;    // in the mapping PI
+            int32_t  bit_size;
+        };
+        std::vector<PIEntry> input_entries;   // mapped PDO entries (padding included), built by the mapping creation
+        std::vector<PIEntry> output_entries;
+
+        struct PDOObject
+        {
+            uint16_t index;
+            uint8_t  subindex;
+            uint8_t  bit_size;
+        };
+        bool is_pdo_remapped{false};            // write the requested PDO mapping: see Bus::requestPDOMapping()
+        std::vector<PDOObject> rx_pdo_request;  // outputs
+        std::vector<PDOObject> tx_pdo_request;  // inputs
+
+        // Asynchronous state transition of this slave: see Bus::requestState(Slave&, State, nanoseconds)
+        struct StateRequest
+        {
+            enum Status : uint8_t
+            {
+                NONE,       // no request
+                REQUESTED,  // AL control to write
+                PENDING,    // AL control written, AL status polled
+                DONE,       // state reached
+                FAILED,     // transition refused by the slave: see al_status_code
+                TIMEOUT
+            };
+            State target{State::INVALID};
+            Status status{NONE};
+            nanoseconds deadline{0};
+        };
+        StateRequest state_request;
 
         ErrorCounters error_counters;
 
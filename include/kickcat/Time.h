@@ -14,6 +14,12 @@ namespace kickcat
     nanoseconds since_epoch();
 
     nanoseconds elapsed_time(nanoseconds start = since_epoch());
+
+    // return the time in ns of a monotonic clock (not affected by system time changes): use it for periodic deadlines
+    nanoseconds monotonic_time();
+
+    // sleep until an absolute deadline of the monotonic clock (no drift: the time spent before the call does not matter)
+    void sleep_until(nanoseconds deadline);
 }
 
 #endif
@@ -0,0 +1,79 @@
+#ifndef KICKCAT_TRACER_H
+#define KICKCAT_TRACER_H
+
+#include <string>
+#include <vector>
+
+#include "Time.h"
+
+namespace kickcat
+{
+    /// \brief Timeline of the bus operations (init phases, state polling, SDO, frames), saved in the Chrome trace event
+    ///        format: open it in Perfetto (ui.perfetto.dev) or chrome://tracing
+    /// \details Tracing is enabled by giving a tracer to the bus (Bus::setTracer()). Without tracer, a trace point is a
+    ///          null pointer check: no clock read, no allocation.
+    class Tracer
+    {
+    public:
+        // Timeline lanes (Chrome trace thread id)
+        static constexpr int32_t BUS  = 0;      // bus operations
+        static constexpr int32_t LINK = 1;      // frames, from emission to answer reception
+        static constexpr int32_t SLAVE = 2;     // per slave operations: lane SLAVE + slave address
+
+        struct Event
+        {
+            std::string name;
+            char const* category;
+            nanoseconds start;                  // since epoch
+            nanoseconds duration;
+            int32_t lane;
+        };
+
+        void add(std::string name, char const* category, nanoseconds start, nanoseconds end, int32_t lane = BUS)
+        { events_.push_back({std::move(name), category, start, end - start, lane}); }
+
+        std::vector<Event> const& events() const { return events_; }
+        void clear() { events_.clear(); }
+
+        // Write the events as a JSON trace file - the timeline starts at the first event
+        void save(std::string const& path) const;
+
+        /// \brief Event covering a scope of the BUS lane, recorded on its exit - nothing is done if the tracer is null
+        class Scope
+        {
+        public:
+            Scope(Tracer* tracer, char const* name, char const* category = "bus")
+                : tracer_{tracer}
+                , name_{name}
+                , category_{category}
+            {
+                if (tracer_ != nullptr)
+                {
+                    start_ = since_epoch();
+                }
+            }
+
+            ~Scope()
+            {
+                if (tracer_ != nullptr)
+                {
+                    tracer_->add(name_, category_, start_, since_epoch());
+                }
+            }
+
+            Scope(Scope const&) = delete;
+            Scope& operator=(Scope const&) = delete;
+
+        private:
+            Tracer* tracer_;
+            char const* name_;
+            char const* category_;
+            nanoseconds start_{0};
+        };
+
+    private:
+        std::vector<Event> events_;
+    };
+}
+
+#endif
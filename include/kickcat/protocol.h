@@ -359,6 +359,8 @@ namespace kickcat
     {
         constexpr uint16_t SM_COM_TYPE       = 0x1C00; // each sub-entry described SM[x] com type (mailbox in/out, PDO in/out, not used)
         constexpr uint16_t SM_CHANNEL        = 0x1C10; // each entry is associated with the mapped PDOs (if in used)
+        constexpr uint16_t RxPDO_MAPPING     = 0x1600; // first RxPDO mapping object (outputs)
+        constexpr uint16_t TxPDO_MAPPING     = 0x1A00; // first TxPDO mapping object (inputs)
 
         enum Service
         {
@@ -1,7 +1,10 @@
+#include <array>
 #include <cstring>
+#include <algorithm>
 
 #include "Bus.h"
 #include "AbstractSocket.h"
+#include "Bits.h"
 
 namespace kickcat
 {
@@ -41,6 +44,8 @@ namespace kickcat
 
     void Bus::detectSlaves()
     {
+        Tracer::Scope trace(tracer_, "detectSlaves");
+
         // we dont really care about the type, we just want a working counter to detect the number of slaves
         uint16_t wkc = broadcastRead(reg::TYPE, 1);
         if (wkc == 0)
@@ -48,26 +53,328 @@ namespace kickcat
             THROW_ERROR("Invalid working counter");
         }
 
+        mailbox_status_slaves_.clear();  // slaves are detected again: the mapping has to be created again
+
+        // requests of the previous slaves are cancelled: their owners are called back before the slaves are reused
+        cancelSDORequests();
+        processSDORequests();
+        cancelSDORequests();             // requests queued by the callbacks are dropped
+        sdo_requests_.clear();
+
         slaves_.resize(wkc);
         DEBUG_PRINT("%lu slave detected on the network\n", slaves_.size());
     }
 
 
     void Bus::init()
+    {
+        Tracer::Scope trace(tracer_, "init");
+        int64_t round_trips = link_.roundTrips();
+        int64_t frames = link_.sentFrames();
+
+        resetBus();
+        fetchEeprom();
+        enterPreOp();
+
+        init_round_trips_ = static_cast<int32_t>(link_.roundTrips() - round_trips);
+        DEBUG_PRINT("init: %d round trips, %ld frames\n", init_round_trips_, link_.sentFrames() - frames);
+    }
+
+
+    void Bus::init(BusConfig const& config)
+    {
+        Tracer::Scope trace(tracer_, "init (bus configuration)");
+        int64_t round_trips = link_.roundTrips();
+        int64_t frames = link_.sentFrames();
+
+        resetBus();
+        if (slaves_.size() != config.slaves.size())
+        {
+            DEBUG_PRINT("%zu slaves expected, %zu detected\n", config.slaves.size(), slaves_.size());
+            THROW_ERROR_CODE("Bus configuration mismatch: slaves count", slaves_.size());
+        }
+
+        fetchEeprom(true);
+        for (std::size_t i = 0; i < slaves_.size(); ++i)
+        {
+            Slave& slave = slaves_[i];
+            SlaveConfig const& expected = config.slaves[i];
+            if ((slave.vendor_id       != expected.vendor_id)
+             or (slave.product_code    != expected.product_code)
+             or (slave.revision_number != expected.revision_number)
+             or (slave.serial_number   != expected.serial_number))
+            {
+                DEBUG_PRINT("slave %zu: expected %08x:%08x:%08x:%08x, detected %08x:%08x:%08x:%08x\n", i,
+                            expected.vendor_id, expected.product_code, expected.revision_number, expected.serial_number,
+                            slave.vendor_id, slave.product_code, slave.revision_number, slave.serial_number);
+                THROW_ERROR_CODE("Bus configuration mismatch: slave identity", i);
+            }
+            applyConfig(slave, expected, i);
+        }
+
+        enterPreOp();
+
+        // startup SDOs: every slave mailbox at once
+        Tracer::Scope trace_sdo(tracer_, "startup SDOs");
+        std::vector<SDOChain> chains;
+        for (std::size_t i = 0; i < slaves_.size(); ++i)
+        {
+            if (config.slaves[i].sdos.empty())
+            {
+                continue;
+            }
+            chains.push_back({});
+            chains.back().slave = &slaves_[i];
+            for (auto const& sdo : config.slaves[i].sdos)
+            {
+                chainWriteSDO(chains.back(), sdo.index, sdo.subindex, sdo.value, sdo.size);
+            }
+        }
+        processSDOChains(chains, 1s);
+
+        init_round_trips_ = static_cast<int32_t>(link_.roundTrips() - round_trips);
+        DEBUG_PRINT("init: %d round trips, %ld frames\n", init_round_trips_, link_.sentFrames() - frames);
+    }
+
+
+    void Bus::attach(BusConfig const& config, uint8_t* iomap)
+    {
+        Tracer::Scope trace(tracer_, "attach");
+        int64_t round_trips = link_.roundTrips();
+        int64_t frames = link_.sentFrames();
+
+        detectSlaves();
+        if (slaves_.size() != config.slaves.size())
+        {
+            DEBUG_PRINT("%zu slaves expected, %zu detected\n", config.slaves.size(), slaves_.size());
+            THROW_ERROR_CODE("Warm attach mismatch: slaves count", slaves_.size());
+        }
+
+        // Configuration left by the previous master, read by position: station address, AL status, SyncManagers and
+        // process data FMMUs of every slave in the same frames
+        struct Registers
+        {
+            uint16_t address;
+            uint8_t  al_status[6];
+            SyncManager sm[16];
+            FMMU fmmu[3];       // outputs, inputs, mailbox status
+        };
+        std::vector<Registers> registers(slaves_.size());
+
+        auto error = [](){ THROW_ERROR("Invalid working counter"); };
+        auto read = [&](size_t position, uint16_t ADO, void* destination, uint16_t size)
+        {
+            auto process = [destination, size](DatagramHeader const*, uint8_t const* data, uint16_t wkc)
+            {
+                if (wkc != 1)
+                {
+                    return true;
+                }
+                std::memcpy(destination, data, size);
+                return false;
+            };
+            link_.addDatagram(Command::APRD, createAddress(0 - position, ADO), nullptr, size, process, error);
+        };
+        for (size_t i = 0; i < slaves_.size(); ++i)
+        {
+            read(i, reg::STATION_ADDR, &registers[i].address,  sizeof(Registers::address));
+            read(i, reg::AL_STATUS,    registers[i].al_status, sizeof(Registers::al_status));
+            read(i, reg::SYNC_MANAGER, registers[i].sm,        sizeof(Registers::sm));
+            read(i, reg::FMMU,         registers[i].fmmu,      sizeof(Registers::fmmu));
+
+            // 4 datagrams per slave: stay below the datagrams in flight limit on big networks
+            if ((i % 32) == 31)
+            {
+                link_.processDatagrams();
+            }
+        }
+        link_.processDatagrams();
+
+        for (size_t i = 0; i < slaves_.size(); ++i)
+        {
+            Slave& slave = slaves_[i];
+            slave.address = static_cast<uint16_t>(i);
+            slave.al_status = registers[i].al_status[0];
+            std::memcpy(&slave.al_status_code, registers[i].al_status + 4, sizeof(slave.al_status_code));
+            if (registers[i].address != slave.address)
+            {
+                DEBUG_PRINT("slave %zu: station address %04x\n", i, registers[i].address);
+                THROW_ERROR_CODE("Warm attach mismatch: station address", i);
+            }
+
+            // an outputs watchdog expiration while the master was down leaves the slave in SAFE_OP with the error flag set
+            State state = State(slave.al_status & 0xF);
+            if ((state != State::PRE_OP) and (state != State::SAFE_OP) and (state != State::OPERATIONAL))
+            {
+                DEBUG_PRINT("slave %zu: state %02x\n", i, slave.al_status);
+                THROW_ERROR_CODE("Warm attach mismatch: slave state", i);
+            }
+        }
+
+        fetchEeprom(true);
+        for (size_t i = 0; i < slaves_.size(); ++i)
+        {
+            Slave& slave = slaves_[i];
+            SlaveConfig const& expected = config.slaves[i];
+            if ((slave.vendor_id       != expected.vendor_id)
+             or (slave.product_code    != expected.product_code)
+             or (slave.revision_number != expected.revision_number)
+             or (slave.serial_number   != expected.serial_number))
+            {
+                THROW_ERROR_CODE("Warm attach mismatch: slave identity", i);
+            }
+            applyConfig(slave, expected, i);
+        }
+
+        // same mapping computation than the previous master: the slaves FMMUs are checked instead of programmed
+        detectMapping();
+        buildPIFrames();
+        mapClientBuffer(iomap);
+
+        auto isSameSM = [](SyncManager const& expected, SyncManager const& actual)
+        {
+            return (expected.start_address == actual.start_address)
+               and (expected.length        == actual.length)
+               and (expected.control       == actual.control)
+               and ((expected.activate & 1) == (actual.activate & 1));
+        };
+        for (size_t i = 0; i < slaves_.size(); ++i)
+        {
+            Slave& slave = slaves_[i];
+            bool is_same = true;
+            if (slave.supported_mailbox)
+            {
+                SyncManager SM[2];
+                slave.mailbox.generateSMConfig(SM);
+                is_same = isSameSM(SM[0], registers[i].sm[0]) and isSameSM(SM[1], registers[i].sm[1]);
+            }
+
+            for (auto [mapping, type, fmmu] : {std::make_tuple(&slave.input,  SyncManagerType::Input,  1),
+                                               std::make_tuple(&slave.output, SyncManagerType::Output, 0)})
+            {
+                if (mapping->bsize == 0)
+                {
+                    continue;
+                }
+                if ((mapping->sync_manager < 0) or (mapping->sync_manager >= 16)
+                 or (mapping->sync_manager >= static_cast<int32_t>(slave.sii.syncManagers_.size())))
+                {
+                    THROW_ERROR_CODE("Warm attach: mapping on an unknown SyncManager", i);
+                }
+                PIConfig expected = generatePIConfig(slave, *mapping, type);
+                is_same = is_same
+                      and isSameSM(expected.sm, registers[i].sm[mapping->sync_manager])
+                      and (std::memcmp(&expected.fmmu, &registers[i].fmmu[fmmu], sizeof(FMMU)) == 0);
+            }
+
+            if (not is_same)
+            {
+                THROW_ERROR_CODE("Warm attach mismatch: SyncManagers or FMMUs", i);
+            }
+        }
+
+        for (size_t i = 0; i < mailbox_status_slaves_.size(); ++i)
+        {
+            FMMU expected = generateMailboxStatusFMMU(static_cast<int32_t>(i));
+            size_t position = static_cast<size_t>(mailbox_status_slaves_[i] - slaves_.data());
+            if (std::memcmp(&expected, &registers[position].fmmu[2], sizeof(FMMU)) != 0)
+            {
+                THROW_ERROR_CODE("Warm attach mismatch: mailbox status FMMU", position);
+            }
+        }
+
+        setupMailboxes();
+
+        init_round_trips_ = static_cast<int32_t>(link_.roundTrips() - round_trips);
+        DEBUG_PRINT("attach: %d round trips, %ld frames\n", init_round_trips_, link_.sentFrames() - frames);
+    }
+
+
+    void Bus::applyConfig(Slave& slave, SlaveConfig const& config, std::size_t position)
+    {
+        slave.mailbox.recv_offset = config.recv_offset;
+        slave.mailbox.recv_size   = config.recv_size;
+        slave.mailbox.send_offset = config.send_offset;
+        slave.mailbox.send_size   = config.send_size;
+        slave.supported_mailbox   = static_cast<eeprom::MailboxProtocol>(config.supported_mailbox);
+
+        // SyncManagers are described as an SII category: the slave owns them like discovered ones
+        uint32_t sm_words = static_cast<uint32_t>(config.sync_managers.size() * sizeof(eeprom::SyncManagerEntry) / 2);
+        std::vector<uint32_t> buffer(1 + sm_words / 2);
+        buffer[0] = eeprom::Category::SyncM | (sm_words << 16);
+        std::memcpy(buffer.data() + 1, config.sync_managers.data(), sm_words * 2);
+        buffer.push_back(0xFFFFFFFF);   // end category
+
+        slave.sii = Slave::SII{};
+        slave.sii.buffer = std::move(buffer);
+        slave.parseSII();
+
+        // known mapping: no detection
+        slave.is_static_mapping = true;
+        auto describe = [](SlaveConfig::Mapping const& expected, Slave::PIMapping& mapping, std::vector<Slave::PIEntry>& entries)
+        {
+            mapping.size = expected.size;
+            mapping.bsize = (expected.size + 7) / 8;
+            mapping.sync_manager = expected.sync_manager;
+            entries.clear();
+            int32_t offset = 0;
+            for (auto const& entry : expected.entries)
+            {
+                entries.push_back({entry.index, entry.subindex, {}, offset, entry.bit_size});
+                offset += entry.bit_size;
+            }
+        };
+        describe(config.input,  slave.input,  slave.input_entries);
+        describe(config.output, slave.output, slave.output_entries);
+
+        // the SyncManager of a mapping is one of the described ones: the FMMUs configuration reads it
+        for (auto const* mapping : {&config.input, &config.output})
+        {
+            if ((mapping->size > 0)
+            and ((mapping->sync_manager < 0) or (mapping->sync_manager >= static_cast<int32_t>(config.sync_managers.size()))))
+            {
+                THROW_ERROR_CODE("Invalid mapping SyncManager in the bus configuration", position);
+            }
+        }
+    }
+
+
+    void Bus::resetBus()
     {
         detectSlaves();
-        resetSlaves();
-        setAddresses();
 
-        requestState(State::INIT);
+        // reset, addresses and INIT request sent together: the slaves process the datagrams in order
+        {
+            Tracer::Scope trace(tracer_, "resetSlaves");
+            sendResetSlaves();
+            sendAddresses();
+            sendRequestState(State::INIT);
+            link_.processDatagrams();
+        }
+
         waitForState(State::INIT, 5000ms);
+    }
 
-        fetchEeprom();
-        configureMailboxes();
 
-        requestState(State::PRE_OP);
+    void Bus::enterPreOp()
+    {
+        {
+            Tracer::Scope trace(tracer_, "configureMailboxes");
+            sendMailboxesConfiguration();
+            sendRequestState(State::PRE_OP);
+            link_.processDatagrams();
+        }
+
         waitForState(State::PRE_OP, 3000ms);
 
+        setupMailboxes();
+    }
+
+
+    void Bus::setupMailboxes()
+    {
+        Tracer::Scope trace(tracer_, "setupMailboxes");
+
         // clear mailboxes
         auto error_callback = [](){ THROW_ERROR("init error while cleaning slaves mailboxes"); };
         checkMailboxes(error_callback);
@@ -87,12 +394,21 @@ namespace kickcat
 
     void Bus::requestState(State request)
     {
-        uint16_t param = request | State::ACK;
-        uint16_t wkc = broadcastWrite(reg::AL_CONTROL, &param, sizeof(param));
-        if (wkc != slaves_.size())
+        sendRequestState(request);
+        link_.processDatagrams();
+    }
+
+
+    void Bus::sendRequestState(State request)
+    {
+        auto process = [this](DatagramHeader const*, uint8_t const*, uint16_t wkc)
         {
-            THROW_ERROR("Invalid working counter");
-        }
+            return (wkc != slaves_.size());
+        };
+        auto error = [](){ THROW_ERROR("Invalid working counter"); };
+
+        uint16_t param = request | State::ACK;
+        link_.addDatagram(Command::BWR, createAddress(0, reg::AL_CONTROL), param, process, error);
     }
 
 
@@ -124,7 +440,12 @@ namespace kickcat
 
         sendGetALStatus(slave, error);
         link_.processDatagrams();
+        return decodeState(slave);
+    }
 
+
+    State Bus::decodeState(Slave const& slave)
+    {
         // error indicator flag set: check status code
         if (slave.al_status & 0x10)
         {
@@ -138,25 +459,80 @@ namespace kickcat
     }
 
 
-    void Bus::waitForState(State request, nanoseconds timeout)
+    bool Bus::isStateReached(State request)
     {
-        nanoseconds now = since_epoch();
-
-        while (true)
+        // Whole bus precheck: AL status of every slave ORed by a broadcast read. States are one-hot (but BOOT):
+        // the result is the requested state only if every slave is in it.
+        bool is_one_hot = (request != State::BOOT) and (request != State::INVALID);
+        if (is_state_precheck_enabled_ and is_one_hot)
         {
-            sleep(big_wait);
+            uint8_t states = 0;
+            uint16_t answers = 0;
+            auto process = [&states, &answers](DatagramHeader const*, uint8_t const* data, uint16_t wkc)
+            {
+                states = data[0];
+                answers = wkc;
+                return false;
+            };
+            auto error = [](){ DEBUG_PRINT("Error while trying to get the bus state.\n"); };
+            link_.addDatagram(Command::BRD, createAddress(0, reg::AL_STATUS), nullptr, 1, process, error);
+            link_.processDatagrams();
 
-            bool is_state_reached = true;
-            for (auto& slave : slaves_)
+            if ((answers == slaves_.size()) and ((states & 0x10) == 0))
             {
-                State state = getCurrentState(slave);
-                if (state != request)
+                if (states != request)
+                {
+                    return false;
+                }
+                for (auto& slave : slaves_)
                 {
-                    is_state_reached = false;
-                    break;
+                    slave.al_status = request;
+                    slave.al_status_code = 0;
                 }
+                return true;
+            }
+            // a slave reports an error or does not answer: read them one by one
+        }
+
+        auto error = []()
+        {
+            DEBUG_PRINT("Error while trying to get slave state.\n");
+        };
+
+        // every slave status in the same frames
+        for (auto& slave : slaves_)
+        {
+            sendGetALStatus(slave, error);
+        }
+        link_.processDatagrams();
+
+        bool is_state_reached = true;
+        for (auto const& slave : slaves_)
+        {
+            if (decodeState(slave) != request)
+            {
+                is_state_reached = false;
             }
+        }
+        return is_state_reached;
+    }
+
+
+    void Bus::waitForState(State request, nanoseconds timeout)
+    {
+        // Poll at once, then with an interval growing from tiny_wait to big_wait: the wait ends as soon as the slowest
+        // slave is ready, without loading the bus during long transitions.
+        Tracer::Scope trace(tracer_, "waitForState");
+        nanoseconds now = since_epoch();
+        nanoseconds interval = tiny_wait;
 
+        while (true)
+        {
+            bool is_state_reached;
+            {
+                Tracer::Scope trace_poll(tracer_, "isStateReached");
+                is_state_reached = isStateReached(request);
+            }
             if (is_state_reached)
             {
                 return;
@@ -166,185 +542,550 @@ namespace kickcat
             {
                 THROW_ERROR("Timeout");
             }
+
+            sleep(interval);
+            interval = std::min(interval * 2, big_wait);
         }
     }
 
 
-    void Bus::resetSlaves()
+    void Bus::requestState(Slave& slave, State request, nanoseconds timeout)
     {
-        // buffer to reset them all
-        uint8_t param[256];
-        std::memset(param, 0, sizeof(param));
-
-        // Set port to auto mode
-        broadcastWrite(reg::ESC_DL_PORT,        param, 1);
-
-        // Reset slaves registers
-        clearErrorCounters();
-        broadcastWrite(reg::FMMU,               param, 256);
-        broadcastWrite(reg::SYNC_MANAGER,       param, 128);
-        broadcastWrite(reg::DC_SYSTEM_TIME,     param, 8);
-        broadcastWrite(reg::DC_SYNC_ACTIVATION, param, 1);
-
-        uint16_t dc_param = 0x1000; // reset value
-        broadcastWrite(reg::DC_SPEED_CNT_START, &dc_param, sizeof(dc_param));
-
-        dc_param = 0x0c00;          // reset value
-        broadcastWrite(reg::DC_TIME_FILTER, &dc_param, sizeof(dc_param));
-
-        // eeprom to master
-        broadcastWrite(reg::EEPROM_CONFIG, param, 2);
+        slave.state_request.target   = request;
+        slave.state_request.status   = Slave::StateRequest::REQUESTED;
+        slave.state_request.deadline = since_epoch() + timeout;
     }
 
 
-    void Bus::setAddresses()
+    void Bus::requestGroupState(int32_t group, State request, nanoseconds timeout)
     {
-        for (size_t i = 0; i < slaves_.size(); ++i)
+        for (auto& slave : slaves_)
         {
-            auto process = [](DatagramHeader const*, uint8_t const*, uint16_t wkc)
-            {
-                if (wkc != 1)
-                {
-                    return true;
-                }
-                return false;
-            };
-
-            auto error = []()
+            if (slave.group == group)
             {
-                THROW_ERROR("Invalid working counter");
-            };
-
-            slaves_[i].address = static_cast<uint16_t>(i);
-            link_.addDatagram(Command::APWR, createAddress(0 - i, reg::STATION_ADDR), slaves_[i].address, process, error);
+                requestState(slave, request, timeout);
+            }
         }
-
-        link_.processDatagrams();
     }
 
 
-    void Bus::configureMailboxes()
+    bool Bus::isStateRequestPending() const
     {
-        auto process = [](DatagramHeader const*, uint8_t const*, uint16_t wkc)
+        for (auto const& slave : slaves_)
         {
-            if (wkc != 1)
+            if ((slave.state_request.status == Slave::StateRequest::REQUESTED)
+             or (slave.state_request.status == Slave::StateRequest::PENDING))
             {
                 return true;
             }
-            return false;
-        };
-
-        auto error = []()
-        {
-            THROW_ERROR("Invalid working counter");
-        };
-
-        for (auto& slave : slaves_)
-        {
-            if (slave.supported_mailbox)
-            {
-                SyncManager SM[2];
-                slave.mailbox.generateSMConfig(SM);
-                link_.addDatagram(Command::FPWR, createAddress(slave.address, reg::SYNC_MANAGER), SM, process, error);
-            }
         }
-
-        link_.processDatagrams();
+        return false;
     }
 
 
-    void Bus::detectMapping()
+    void Bus::sendStateRequests(std::function<void()> const& error, nanoseconds now)
     {
-        // helper: compute byte size from bit size, round up
-        auto bits_to_bytes = [](int32_t bits) -> int32_t
+        for (auto& slave : slaves_)
         {
-            int32_t bytes = bits / 8;
-            if (bits % 8)
+            Slave::StateRequest& request = slave.state_request;
+            if ((request.status != Slave::StateRequest::REQUESTED) and (request.status != Slave::StateRequest::PENDING))
             {
-                bytes += 1;
+                continue;
             }
-            return bytes;
-        };
 
-        // Determines PI sizes for each slave
-        for (auto& slave : slaves_)
-        {
-            if (slave.is_static_mapping)
+            if (now > request.deadline)
             {
-                slave.input.size  = slave.input.bsize  * 8;
-                slave.output.size = slave.output.bsize * 8;
+                DEBUG_PRINT("Slave %04x: state request timeout\n", slave.address);
+                request.status = Slave::StateRequest::TIMEOUT;
                 continue;
             }
 
-            if (slave.supported_mailbox & eeprom::MailboxProtocol::CoE)
+            if (request.status == Slave::StateRequest::REQUESTED)
             {
-                // Slave support CAN over EtherCAT -> use mailbox/SDO to get mapping size
-                uint8_t sm[512];
-                uint32_t sm_size = sizeof(sm);
-                readSDO(slave, CoE::SM_COM_TYPE, 1, Access::EMULATE_COMPLETE, sm, &sm_size);
-
-                for (uint32_t i = 0; i < sm_size; ++i)
+                // not written (lost frame, invalid working counter): written again by the next call
+                auto process = [&request](DatagramHeader const*, uint8_t const*, uint16_t wkc)
                 {
-                    //TODO we support only one input and one output per slave for now
-                    if (sm[i] <= 2) // mailboxes
+                    if (wkc != 1)
                     {
-                        continue;
+                        return true;
                     }
+                    request.status = Slave::StateRequest::PENDING;
+                    return false;
+                };
 
-                    Slave::PIMapping* mapping = &slave.input;
-                    if (sm[i] == SyncManagerType::Output)
-                    {
-                        mapping = &slave.output;
+                uint16_t param = request.target | State::ACK;
+                link_.addDatagram(Command::FPWR, createAddress(slave.address, reg::AL_CONTROL), &param, sizeof(param), process, error);
+                continue;
+            }
+
+            auto process = [&slave](DatagramHeader const*, uint8_t const* data, uint16_t wkc)
+            {
+                Slave::StateRequest& answer = slave.state_request;
+                if (wkc != 1)
+                {
+                    return true;    // polled again by the next call
+                }
+                if (answer.status != Slave::StateRequest::PENDING)
+                {
+                    return false;   // timeout or new request meanwhile
+                }
+
+                slave.al_status = data[0];
+                slave.al_status_code = *reinterpret_cast<uint16_t const*>(data + 4);
+                if ((slave.al_status & 0x10) and (slave.al_status_code != 0))
+                {
+                    DEBUG_PRINT("Slave %04x: state transition error %04x\n", slave.address, slave.al_status_code);
+                    answer.status = Slave::StateRequest::FAILED;
+                }
+                else if ((slave.al_status & 0xF) == answer.target)
+                {
+                    answer.status = Slave::StateRequest::DONE;
+                }
+                return false;
+            };
+            link_.addDatagram(Command::FPRD, createAddress(slave.address, reg::AL_STATUS), nullptr, 6, process, error);
+        }
+        link_.finalizeDatagrams();
+    }
+
+
+    void Bus::sendResetSlaves()
+    {
+        // buffer to reset them all
+        static constexpr uint8_t param[256] = {0};
+        static constexpr uint16_t dc_speed_start = 0x1000;  // reset value
+        static constexpr uint16_t dc_time_filter = 0x0c00;  // reset value
+
+        auto process = [](DatagramHeader const*, uint8_t const*, uint16_t) { return false; };
+        auto error = [](){ THROW_ERROR("init error while resetting slaves"); };
+        auto reset = [&](uint16_t ADO, void const* data, uint16_t data_size)
+        {
+            link_.addDatagram(Command::BWR, createAddress(0, ADO), data, data_size, process, error);
+        };
+
+        // Set port to auto mode
+        reset(reg::ESC_DL_PORT, param, 1);
+
+        // Reset slaves registers
+        // Note: error counters value is not taken into account by the slave and result will always be zero
+        auto process_counters = [this](DatagramHeader const*, uint8_t const*, uint16_t wkc)
+        {
+            return (wkc != slaves_.size());
+        };
+        auto error_counters = [](){ THROW_ERROR("Invalid working counter"); };
+        link_.addDatagram(Command::BWR, createAddress(0, reg::ERROR_COUNTERS), param, 20, process_counters, error_counters);
+
+        reset(reg::FMMU,               param, 256);
+        reset(reg::SYNC_MANAGER,       param, 128);
+        reset(reg::DC_SYSTEM_TIME,     param, 8);
+        reset(reg::DC_SYNC_ACTIVATION, param, 1);
+        reset(reg::DC_SPEED_CNT_START, &dc_speed_start, sizeof(dc_speed_start));
+        reset(reg::DC_TIME_FILTER,     &dc_time_filter, sizeof(dc_time_filter));
+
+        // eeprom to master
+        reset(reg::EEPROM_CONFIG, param, 2);
+    }
+
+
+    void Bus::sendAddresses()
+    {
+        auto process = [](DatagramHeader const*, uint8_t const*, uint16_t wkc)
+        {
+            if (wkc != 1)
+            {
+                return true;
+            }
+            return false;
+        };
+
+        auto error = []()
+        {
+            THROW_ERROR("Invalid working counter");
+        };
+
+        for (size_t i = 0; i < slaves_.size(); ++i)
+        {
+            slaves_[i].address = static_cast<uint16_t>(i);
+            link_.addDatagram(Command::APWR, createAddress(0 - i, reg::STATION_ADDR), slaves_[i].address, process, error);
+
+            // stay below the datagrams in flight limit on big networks
+            if ((i % 128) == 127)
+            {
+                link_.processDatagrams();
+            }
+        }
+    }
+
+
+    void Bus::sendMailboxesConfiguration()
+    {
+        auto process = [](DatagramHeader const*, uint8_t const*, uint16_t wkc)
+        {
+            if (wkc != 1)
+            {
+                return true;
+            }
+            return false;
+        };
+
+        auto error = []()
+        {
+            THROW_ERROR("Invalid working counter");
+        };
+
+        int32_t count = 0;
+        for (auto& slave : slaves_)
+        {
+            if (slave.supported_mailbox)
+            {
+                SyncManager SM[2];
+                slave.mailbox.generateSMConfig(SM);
+                link_.addDatagram(Command::FPWR, createAddress(slave.address, reg::SYNC_MANAGER), SM, process, error);
+
+                // stay below the datagrams in flight limit on big networks
+                if ((++count % 128) == 0)
+                {
+                    link_.processDatagrams();
+                }
+            }
+        }
+    }
+
+
+    void Bus::detectMapping()
+    {
+        Tracer::Scope trace(tracer_, "detectMapping");
+
+        // helper: compute byte size from bit size, round up
+        auto bits_to_bytes = [](int32_t bits) -> int32_t
+        {
+            int32_t bytes = bits / 8;
+            if (bits % 8)
+            {
+                bytes += 1;
+            }
+            return bytes;
+        };
+
+        // helper: name of a PDO entry from the SII, empty if unknown
+        auto siiName = [](Slave const& slave, uint16_t index, uint8_t subindex) -> std::string
+        {
+            for (auto const* pdos : {&slave.sii.TxPDO, &slave.sii.RxPDO})
+            {
+                for (auto const& pdo : *pdos)
+                {
+                    if ((pdo->index == index) and (pdo->subindex == subindex) and (pdo->name < slave.sii.strings.size()))
+                    {
+                        return std::string(slave.sii.strings[pdo->name]);
                     }
-                    mapping->sync_manager = i;
+                }
+            }
+            return {};
+        };
+
+        // Determines PI sizes for each slave
+        std::vector<SDOChain> chains;
+        for (auto& slave : slaves_)
+        {
+            if (slave.is_static_mapping)
+            {
+                // user mapping: entries and bit size are optional (i.e. from a bus configuration)
+                if (slave.input_entries.empty())
+                {
+                    slave.input.size = slave.input.bsize * 8;
+                }
+                if (slave.output_entries.empty())
+                {
+                    slave.output.size = slave.output.bsize * 8;
+                }
+                continue;
+            }
+
+            slave.input_entries.clear();
+            slave.output_entries.clear();
+
+            if (slave.supported_mailbox & eeprom::MailboxProtocol::CoE)
+            {
+                // Slave support CAN over EtherCAT -> use mailbox/SDO to get mapping size (see below)
+                // A mapping without SyncManager in the object dictionary stays empty.
+                for (auto* mapping : {&slave.input, &slave.output})
+                {
                     mapping->size = 0;
+                    mapping->bsize = 0;
+                    mapping->sync_manager = -1;
+                }
+                chains.push_back({});
+                chains.back().slave = &slave;
+                continue;
+            }
+
+            // unsupported mailbox: use SII to get the mapping size
+            Slave::PIMapping* mapping = &slave.output;
+            mapping->sync_manager = 0;
+            mapping->size = 0;
+            for (auto const& pdo : slave.sii.RxPDO)
+            {
+                slave.output_entries.push_back({pdo->index, pdo->subindex, siiName(slave, pdo->index, pdo->subindex), mapping->size, pdo->bitlen});
+                mapping->size += pdo->bitlen;
+            }
+            mapping->bsize = bits_to_bytes(mapping->size);
 
-                    uint16_t mapped_index[128];
-                    uint32_t map_size = sizeof(mapped_index);
-                    readSDO(slave, CoE::SM_CHANNEL + i, 1, Access::EMULATE_COMPLETE, mapped_index, &map_size);
+            mapping = &slave.input;
+            mapping->sync_manager = 1;
+            mapping->size = 0;
+            for (auto const& pdo : slave.sii.TxPDO)
+            {
+                slave.input_entries.push_back({pdo->index, pdo->subindex, siiName(slave, pdo->index, pdo->subindex), mapping->size, pdo->bitlen});
+                mapping->size += pdo->bitlen;
+            }
+            mapping->bsize = bits_to_bytes(mapping->size);
+        }
 
-                    for (uint32_t j = 0; j < (map_size / 2); ++j)
+        // CoE slaves mapping is read from their object dictionary: one SDO chain per slave, all of them run together
+        struct CoEMapping
+        {
+            uint8_t  sm[512];
+            uint16_t mapped_index[128];
+            uint8_t  object[512];
+        };
+        std::vector<CoEMapping> buffers(chains.size());
+        for (std::size_t c = 0; c < chains.size(); ++c)
+        {
+            CoEMapping* buffer = &buffers[c];
+            chainReadSDO(chains[c], CoE::SM_COM_TYPE, buffer->sm, sizeof(buffer->sm),
+            [buffer, bits_to_bytes, siiName](SDOChain& chain, uint32_t sm_size)
+            {
+                Slave& slave = *chain.slave;
+                for (uint32_t i = 0; i < sm_size; ++i)
+                {
+                    //TODO we support only one input and one output per slave for now
+                    if (buffer->sm[i] <= 2) // mailboxes
                     {
-                        uint8_t object[512];
-                        uint32_t object_size = sizeof(object);
-                        readSDO(slave, mapped_index[j], 1, Access::EMULATE_COMPLETE, object, &object_size);
+                        continue;
+                    }
 
-                        for (uint32_t k = 0; k < object_size; k += 4)
+                    Slave::PIMapping* mapping = &slave.input;
+                    auto* entries = &slave.input_entries;
+                    if (buffer->sm[i] == SyncManagerType::Output)
+                    {
+                        mapping = &slave.output;
+                        entries = &slave.output_entries;
+                    }
+                    mapping->sync_manager = i;
+                    mapping->size = 0;
+                    mapping->bsize = 0;
+
+                    if (slave.is_pdo_remapped)
+                    {
+                        // slave is in PRE_OP: its mapping can be rewritten before reading it back
+                        if (buffer->sm[i] == SyncManagerType::Output)
                         {
-                            mapping->size += object[k];
+                            writePDOMapping(chain, CoE::SM_CHANNEL + i, CoE::RxPDO_MAPPING, slave.rx_pdo_request);
+                        }
+                        else
+                        {
+                            writePDOMapping(chain, CoE::SM_CHANNEL + i, CoE::TxPDO_MAPPING, slave.tx_pdo_request);
                         }
                     }
 
-                    mapping->bsize = bits_to_bytes(mapping->size);
+                    chainReadSDO(chain, CoE::SM_CHANNEL + i, buffer->mapped_index, sizeof(buffer->mapped_index),
+                    [buffer, mapping, entries, bits_to_bytes, siiName](SDOChain& current, uint32_t map_size)
+                    {
+                        for (uint32_t j = 0; j < (map_size / 2); ++j)
+                        {
+                            chainReadSDO(current, buffer->mapped_index[j], buffer->object, sizeof(buffer->object),
+                            [buffer, mapping, entries, bits_to_bytes, siiName](SDOChain& owner, uint32_t object_size)
+                            {
+                                for (uint32_t k = 0; k < object_size; k += 4)
+                                {
+                                    // mapping entry: bit length (8 bits), subindex (8 bits), index (16 bits)
+                                    uint8_t const* object = buffer->object;
+                                    uint16_t index    = static_cast<uint16_t>(object[k + 2] | (object[k + 3] << 8));
+                                    uint8_t  subindex = object[k + 1];
+                                    entries->push_back({index, subindex, siiName(*owner.slave, index, subindex), mapping->size, object[k]});
+                                    mapping->size += object[k];
+                                }
+                                mapping->bsize = bits_to_bytes(mapping->size);
+                            });
+                        }
+                    });
                 }
+            });
+        }
+        processSDOChains(chains, 1s);
+
+        if (is_mailbox_status_mapped_)
+        {
+            fetchFMMUsCount();
+        }
+    }
+
+
+    void Bus::fetchFMMUsCount()
+    {
+        auto error = [](){ THROW_ERROR("Invalid working counter"); };
+        int32_t datagrams = 0;
+        for (auto& slave : slaves_)
+        {
+            slave.esc_fmmus = 0;
+            if (slave.supported_mailbox == 0)
+            {
+                continue;
             }
-            else
+
+            auto process = [&slave](DatagramHeader const*, uint8_t const* data, uint16_t wkc)
             {
-                // unsupported mailbox: use SII to get the mapping size
-                Slave::PIMapping* mapping = &slave.output;
-                mapping->sync_manager = 0;
-                mapping->size = 0;
-                for (auto const& pdo : slave.sii.RxPDO)
+                if (wkc != 1)
                 {
-                    mapping->size += pdo->bitlen;
+                    return true;
                 }
-                mapping->bsize = bits_to_bytes(mapping->size);
+                slave.esc_fmmus = *data;
+                return false;
+            };
+            link_.addDatagram(Command::FPRD, createAddress(slave.address, reg::FMMU_SUP), nullptr, 1, process, error);
+            if ((++datagrams % 128) == 0)
+            {
+                link_.processDatagrams();
+            }
+        }
+        link_.processDatagrams();
+    }
+
+
+    void Bus::buildPIFrames()
+    {
+        Tracer::Scope trace(tracer_, "buildPIFrames");
+
+        // create 'block I/O' lists for read and write op
+        // Note A: the planner chooses the layout - by default offset computing will overlap input and output in the frame
+        //         (better density and compatibility, more works for master)
+        // Note B: a frame cannot handle more than 1486 bytes
+        // Note C: each group is planned on its own and gets its own logical area, after the previous group one
+        std::vector<int32_t> groups;
+        for (auto const& slave : slaves_)
+        {
+            if ((slave.group < 0) or (slave.group >= MAX_GROUPS))
+            {
+                THROW_ERROR("Invalid slave group");
+            }
+            groups.push_back(slave.group);
+        }
+        std::sort(groups.begin(), groups.end());
+        groups.erase(std::unique(groups.begin(), groups.end()), groups.end());
 
-                mapping = &slave.input;
-                mapping->sync_manager = 1;
-                mapping->size = 0;
-                for (auto const& pdo : slave.sii.TxPDO)
+        pi_frames_.clear();
+        plan_ = MappingPlanner::Plan{};
+        plan_.inputs.resize (slaves_.size(), MappingPlanner::Area{-1, 0, 0, false});
+        plan_.outputs.resize(slaves_.size(), MappingPlanner::Area{-1, 0, 0, false});
+
+        uint32_t base_address = 0;
+        for (int32_t group : groups)
+        {
+            std::vector<MappingPlanner::Entry> entries;
+            for (auto const& slave : slaves_)
+            {
+                if (slave.group == group)
                 {
-                    mapping->size += pdo->bitlen;
+                    entries.push_back({slave.input.size, slave.output.size});
+                }
+                else
+                {
+                    entries.push_back({0, 0}); // not part of this group: nothing to map
                 }
-                mapping->bsize = bits_to_bytes(mapping->size);
             }
+            auto plan = planner_.plan(entries);
+
+            int32_t const first_frame = static_cast<int32_t>(plan_.frames.size());
+            for (auto frame : plan.frames)
+            {
+                frame.address += base_address;
+                plan_.frames.push_back(frame);
+                pi_frames_.push_back({frame.address, frame.size, group, {}, {}, nullptr, nullptr, {}, {}, {}, 0ns});
+            }
+
+            auto relocate = [&](MappingPlanner::Area area, MappingPlanner::Area& destination)
+            {
+                if (area.frame >= 0)
+                {
+                    area.frame   += first_frame;
+                    area.address += base_address;
+                    destination = area;
+                }
+            };
+            for (size_t i = 0; i < slaves_.size(); ++i)
+            {
+                relocate(plan.inputs[i],  plan_.inputs[i]);
+                relocate(plan.outputs[i], plan_.outputs[i]);
+            }
+
+            // cost of a cycle where every group is due
+            plan_.layout           = plan.layout;
+            plan_.datagrams       += plan.datagrams;
+            plan_.ethernet_frames += plan.ethernet_frames;
+            plan_.wire_bytes      += plan.wire_bytes;
+            plan_.wire_time       += plan.wire_time;
+
+            base_address += static_cast<uint32_t>(plan.frames.size()) * MAX_ETHERCAT_PAYLOAD_SIZE;
+        }
+
+        // mapped mailboxes status: one bit per mailbox slave with a third FMMU, after the PI areas.
+        // The others slaves mailboxes are checked with FPRD.
+        mailbox_status_address_ = base_address;
+        mailbox_status_slaves_.clear();
+        for (auto& slave : slaves_)
+        {
+            bool has_status_fmmu = (slave.esc_fmmus > 2) and (slave.sii.fmmus_.empty() or (slave.sii.fmmus_.size() > 2));
+            slave.is_mailbox_status_mapped = is_mailbox_status_mapped_ and (slave.supported_mailbox != 0) and has_status_fmmu;
+            if (slave.is_mailbox_status_mapped)
+            {
+                mailbox_status_slaves_.push_back(&slave);
+            }
+        }
+
+        auto addBlock = [this](Slave& slave, Slave::PIMapping& mapping, MappingPlanner::Area const& area, bool is_input)
+        {
+            // save mapping offset (need to configure slave FMMU)
+            mapping.address       = area.address;
+            mapping.start_bit     = area.start_bit;
+            mapping.is_bit_packed = area.is_bit_packed;
+            if (area.frame < 0)
+            {
+                return; // nothing to exchange
+            }
+
+            auto& frame = pi_frames_[area.frame];
+            uint8_t bit_size = 0;
+            if (area.is_bit_packed)
+            {
+                bit_size = static_cast<uint8_t>(mapping.size);
+            }
+
+            blockIO bio{nullptr, area.address - frame.address, mapping.bsize, &slave, area.start_bit, bit_size,
+                        static_cast<int32_t>(&slave - slaves_.data())};
+            if (is_input)
+            {
+                frame.inputs.push_back(bio);
+            }
+            else
+            {
+                frame.outputs.push_back(bio);
+            }
+        };
+
+        for (size_t i = 0; i < slaves_.size(); ++i)
+        {
+            addBlock(slaves_[i], slaves_[i].input,  plan_.inputs[i],  true);
+            addBlock(slaves_[i], slaves_[i].output, plan_.outputs[i], false);
         }
+
+        setupInputChanges();
     }
 
 
     void Bus::createMapping(uint8_t* iomap)
     {
+        Tracer::Scope trace(tracer_, "createMapping");
+
         // First we need to know:
         // - how many bits to map per slave
         // - which SM to use
@@ -352,86 +1093,382 @@ namespace kickcat
         detectMapping();
 
         // Second step: create 'block I/O' lists for read and write op
-        // Note A: offset computing will overlap input and output in the frame (better density and compatibility, more works for master)
-        // Note B: a frame cannot handle more than 1486 bytes
-        pi_frames_.resize(1);
-        pi_frames_[0].address = 0;
-        uint32_t address = 0;
-        for (auto& slave : slaves_)
+        buildPIFrames();
+
+        // Third step: associate client buffer address to block IO and slaves
+        mapClientBuffer(iomap);
+
+        // Fourth step: program FMMUs and SyncManagers
+        configureFMMUs();
+    }
+
+
+    Signal Bus::findSignal(Slave& slave, uint16_t index, uint8_t subindex) const
+    {
+        auto match = [&](Slave::PIEntry const& entry)
+        {
+            return (entry.index == index) and (entry.subindex == subindex);
+        };
+        return findSignal(slave, match);
+    }
+
+
+    Signal Bus::findSignal(Slave& slave, std::string_view name) const
+    {
+        auto match = [&](Slave::PIEntry const& entry)
+        {
+            return (not entry.name.empty()) and (entry.name == name);
+        };
+        return findSignal(slave, match);
+    }
+
+
+    Signal Bus::findSignal(Slave& slave, std::function<bool(Slave::PIEntry const&)> const& match) const
+    {
+        auto find = [&](Slave::PIMapping& mapping, std::vector<Slave::PIEntry> const& entries, Signal& signal)
         {
-            // get the biggest one.
-            int32_t size = std::max(slave.input.bsize, slave.output.bsize);
-            if ((address + size) > (pi_frames_.size() * MAX_ETHERCAT_PAYLOAD_SIZE)) // do we overflow current frame ?
+            for (auto const& entry : entries)
             {
-                pi_frames_.back().size = address - pi_frames_.back().address; // frame size = current address - frame address
+                if ((entry.index == 0) or (not match(entry)))
+                {
+                    continue; // padding or another entry
+                }
 
-                // current size will overflow the frame at the current offset: set in on the next frame
-                address = pi_frames_.size() * MAX_ETHERCAT_PAYLOAD_SIZE;
-                pi_frames_.push_back({address, 0, {}, {}});
+                signal = {&mapping.data, entry.bit_offset, entry.bit_size};
+                if (is_zero_copy_ and mapping.is_bit_packed)
+                {
+                    signal.bit_offset += mapping.start_bit; // data points on the shared logical byte
+                }
+                return true;
             }
+            return false;
+        };
 
-            // create block IO entries
-            pi_frames_.back().inputs.push_back ({nullptr, address - pi_frames_.back().address, slave.input.bsize,  &slave});
-            pi_frames_.back().outputs.push_back({nullptr, address - pi_frames_.back().address, slave.output.bsize, &slave});
+        Signal signal{nullptr, 0, 0};
+        if (find(slave.input, slave.input_entries, signal) or find(slave.output, slave.output_entries, signal))
+        {
+            return signal;
+        }
+        THROW_ERROR("PDO entry is not mapped");
+    }
 
-            // save mapping offset (need to configure slave FMMU)
-            slave.input.address  = address;
-            slave.output.address = address;
 
-            // update offset
-            address += size;
+    int32_t Bus::mappingInputsSize() const
+    {
+        int32_t size = 0;
+        for (auto const& frame : pi_frames_)
+        {
+            for (auto const& bio : frame.inputs)
+            {
+                size += bio.size;
+            }
         }
+        return size;
+    }
 
-        // update last frame size
-        pi_frames_.back().size = address - pi_frames_.back().address;
 
-        // Third step: associate client buffer address to block IO and slaves
+    int32_t Bus::mappingOutputsSize() const
+    {
+        int32_t size = 0;
+        for (auto const& frame : pi_frames_)
+        {
+            for (auto const& bio : frame.outputs)
+            {
+                size += bio.size;
+            }
+        }
+        return size;
+    }
+
+
+    void Bus::mapClientBuffer(uint8_t* iomap)
+    {
+        is_zero_copy_ = false;
+
         // Note: inputs are mapped first, outputs second
         uint8_t* pos = iomap;
         for (auto& frame : pi_frames_)
         {
             for (auto& bio : frame.inputs)
             {
-                bio.iomap = pos;
-                bio.slave->input.data = pos;
-                pos += bio.size;
+                bio.iomap = pos;
+                bio.slave->input.data = pos;
+                pos += bio.size;
+            }
+        }
+        for (auto& frame : pi_frames_)
+        {
+            for (auto& bio : frame.outputs)
+            {
+                bio.iomap = pos;
+                bio.slave->output.data = pos;
+                pos += bio.size;
+            }
+        }
+        for (auto& frame : pi_frames_)
+        {
+            frame.input_runs  = buildCopyRuns(frame.inputs);
+            frame.output_runs = buildCopyRuns(frame.outputs);
+        }
+    }
+
+
+    void Bus::createZeroCopyMapping()
+    {
+        Tracer::Scope trace(tracer_, "createZeroCopyMapping");
+
+        detectMapping();
+        buildPIFrames();
+
+        // PI lives in the link frames: no client buffer
+        is_zero_copy_ = true;
+        link_.releaseZeroCopyFrames();
+        for (auto& frame : pi_frames_)
+        {
+            frame.zero_copy = &link_.createZeroCopyFrame(frame.address, frame.size);
+            for (auto& bio : frame.inputs)
+            {
+                bio.slave->input.data = frame.zero_copy->front() + bio.offset;
+            }
+            for (auto& bio : frame.outputs)
+            {
+                bio.slave->output.data = frame.zero_copy->payload() + bio.offset;
+            }
+        }
+
+        configureFMMUs();
+    }
+
+
+    std::vector<Bus::blockIO> Bus::buildCopyRuns(std::vector<blockIO> const& blocks)
+    {
+        std::vector<blockIO> runs;
+        for (auto const& block : blocks)
+        {
+            if (not runs.empty())
+            {
+                auto& run = runs.back();
+                if ((run.bit_size == 0) and (block.bit_size == 0)
+                    and ((run.iomap  + run.size) == block.iomap)
+                    and ((run.offset + run.size) == block.offset))
+                {
+                    run.size += block.size;
+                    continue;
+                }
+            }
+            runs.push_back(block);
+        }
+        return runs;
+    }
+
+
+    void Bus::readInputs(PIFrame const& pi_frame, uint8_t const* data)
+    {
+        if (pi_frame.input_changes != nullptr)
+        {
+            detectInputChanges(pi_frame, data);
+            return;
+        }
+
+        if (pi_frame.zero_copy != nullptr)
+        {
+            // no copy: inputs are exposed from the frame front buffer
+            pi_frame.zero_copy->swap(data);
+            for (auto const& input : pi_frame.inputs)
+            {
+                input.slave->input.data = pi_frame.zero_copy->front() + input.offset;
+            }
+            return;
+        }
+
+        for (auto const& input : pi_frame.input_runs)
+        {
+            if (input.bit_size == 0)
+            {
+                std::memcpy(input.iomap, data + input.offset, input.size);
+            }
+            else
+            {
+                *input.iomap = static_cast<uint8_t>(readBits(data + input.offset, input.bit_offset, input.bit_size));
+            }
+        }
+    }
+
+
+    bool Bus::updateSentOutputs(PIFrame& pi_frame)
+    {
+        bool changed = false;
+        if (pi_frame.sent_outputs.empty())
+        {
+            pi_frame.sent_outputs.resize(pi_frame.size, 0);
+            changed = true; // never sent
+        }
+        uint8_t* sent = pi_frame.sent_outputs.data();
+
+        if (pi_frame.zero_copy != nullptr)
+        {
+            return copyChanged(sent, pi_frame.zero_copy->payload(), pi_frame.size) or changed;
+        }
+
+        for (auto const& output : pi_frame.output_runs)
+        {
+            if (output.bit_size == 0)
+            {
+                changed |= copyChanged(sent + output.offset, output.iomap, output.size);
+            }
+            else
+            {
+                uint64_t value = *output.iomap & bitMask(output.bit_size);
+                changed |= (readBits(sent + output.offset, output.bit_offset, output.bit_size) != value);
+                writeBits(sent + output.offset, output.bit_offset, output.bit_size, value);
+            }
+        }
+        return changed;
+    }
+
+
+    void Bus::detectInputChanges(PIFrame const& pi_frame, uint8_t const* data)
+    {
+        // slave per slave (merged runs would hide which slave changed): copy or swap, then compare to the previous inputs
+        uint8_t const* previous = nullptr;
+        if (pi_frame.zero_copy != nullptr)
+        {
+            pi_frame.zero_copy->swap(data);
+            data     = pi_frame.zero_copy->front();
+            previous = pi_frame.zero_copy->previous();
+        }
+
+        for (auto const& input : pi_frame.inputs)
+        {
+            bool changed;
+            if (previous != nullptr)
+            {
+                input.slave->input.data = const_cast<uint8_t*>(data) + input.offset;
+                if (input.bit_size == 0)
+                {
+                    changed = (std::memcmp(data + input.offset, previous + input.offset, input.size) != 0);
+                }
+                else
+                {
+                    changed = (readBits(data + input.offset, input.bit_offset, input.bit_size)
+                            != readBits(previous + input.offset, input.bit_offset, input.bit_size));
+                }
+            }
+            else if (input.bit_size == 0)
+            {
+                changed = copyChanged(input.iomap, data + input.offset, input.size);
+            }
+            else
+            {
+                uint8_t value = static_cast<uint8_t>(readBits(data + input.offset, input.bit_offset, input.bit_size));
+                changed = (*input.iomap != value);
+                *input.iomap = value;
+            }
+
+            if (changed)
+            {
+                pi_frame.input_changes[input.index / 64] |= uint64_t{1} << (input.index % 64);
+            }
+        }
+    }
+
+
+    void Bus::setupInputChanges()
+    {
+        input_changes_.assign((slaves_.size() + 63) / 64, 0);
+        for (auto& frame : pi_frames_)
+        {
+            frame.input_changes = nullptr;
+            if (is_input_changes_enabled_)
+            {
+                frame.input_changes = input_changes_.data();
+            }
+        }
+    }
+
+
+    void Bus::enableInputChanges(bool enable)
+    {
+        is_input_changes_enabled_ = enable;
+        setupInputChanges();
+    }
+
+
+    bool Bus::isInputChanged(Slave const& slave) const
+    {
+        std::size_t index = static_cast<std::size_t>(&slave - slaves_.data());
+        if ((index / 64) >= input_changes_.size())
+        {
+            return false;
+        }
+        return (input_changes_[index / 64] >> (index % 64)) & 1;
+    }
+
+
+    void Bus::clearInputChanges()
+    {
+        std::fill(input_changes_.begin(), input_changes_.end(), 0);
+    }
+
+
+    void Bus::writeOutputs(PIFrame const& pi_frame, uint8_t* data)
+    {
+        // unmapped bits (holes, bit packed bytes) shall not carry garbage
+        std::memset(data, 0, pi_frame.size);
+        for (auto const& output : pi_frame.output_runs)
+        {
+            if (output.bit_size == 0)
+            {
+                std::memcpy(data + output.offset, output.iomap, output.size);
             }
-        }
-        for (auto& frame : pi_frames_)
-        {
-            for (auto& bio : frame.outputs)
+            else
             {
-                bio.iomap = pos;
-                bio.slave->output.data = pos;
-                pos += bio.size;
+                writeBits(data + output.offset, output.bit_offset, output.bit_size, *output.iomap);
             }
         }
-
-        // Fourth step: program FMMUs and SyncManagers
-        configureFMMUs();
     }
 
 
     void Bus::sendLogicalRead(std::function<void()> const& error)
+    {
+        sendLogicalRead(error, ALL_GROUPS);
+    }
+
+
+    void Bus::sendLogicalRead(std::function<void()> const& error, uint64_t groups)
     {
         for (auto const& pi_frame : pi_frames_)
         {
-            auto process = [pi_frame](DatagramHeader const*, uint8_t const* data, uint16_t wkc)
+            if (((groups >> pi_frame.group) & 1) == 0)
+            {
+                continue; // group not due
+            }
+
+            if (pi_frame.inputs.empty())
+            {
+                continue; // output only frame
+            }
+
+            auto process = [&pi_frame](DatagramHeader const*, uint8_t const* data, uint16_t wkc)
             {
-                if (wkc != pi_frame.inputs.size())
+                if (wkc != pi_frame.expectedReadWKC())
                 {
                     DEBUG_PRINT("Invalid working counter\n");
                     return true;
                 }
 
-                for (auto& input : pi_frame.inputs)
-                {
-                    std::memcpy(input.iomap, data + input.offset, input.size);
-                }
+                readInputs(pi_frame, data);
                 return false;
             };
 
-            link_.addDatagram(Command::LRD, pi_frame.address, nullptr, pi_frame.size, process, error);
+            if (pi_frame.zero_copy != nullptr)
+            {
+                link_.addDatagram(*pi_frame.zero_copy, Command::LRD, process, error);
+            }
+            else
+            {
+                link_.addDatagram(Command::LRD, pi_frame.address, nullptr, pi_frame.size, process, error);
+            }
         }
         link_.finalizeDatagrams();
     }
@@ -446,23 +1483,53 @@ namespace kickcat
 
     void Bus::sendLogicalWrite(std::function<void()> const& error)
     {
-        for (auto const& pi_frame : pi_frames_)
+        sendLogicalWrite(error, ALL_GROUPS, since_epoch());
+    }
+
+
+    void Bus::sendLogicalWrite(std::function<void()> const& error, uint64_t groups, nanoseconds now)
+    {
+        for (auto& pi_frame : pi_frames_)
         {
-            uint8_t buffer[MAX_ETHERCAT_PAYLOAD_SIZE];
-            for (auto const& output : pi_frame.outputs)
+            if (((groups >> pi_frame.group) & 1) == 0)
+            {
+                continue; // group not due
+            }
+
+            if (pi_frame.outputs.empty())
             {
-                std::memcpy(buffer + output.offset, output.iomap, output.size);
+                continue; // input only frame
             }
 
-            auto process = [pi_frame](DatagramHeader const*, uint8_t const*, uint16_t wkc)
+            if ((static_cast<size_t>(pi_frame.group) < groups_.size()) and (groups_[pi_frame.group].refresh > 0ns))
             {
-                if (wkc != pi_frame.outputs.size())
+                bool changed = updateSentOutputs(pi_frame);
+                if ((not changed) and ((now - pi_frame.last_write) < groups_[pi_frame.group].refresh))
+                {
+                    continue; // unchanged outputs: wait for the forced refresh
+                }
+                pi_frame.last_write = now;
+            }
+
+            auto process = [&pi_frame](DatagramHeader const*, uint8_t const*, uint16_t wkc)
+            {
+                if (wkc != pi_frame.expectedWriteWKC())
                 {
                     DEBUG_PRINT("Invalid working counter\n");
                     return true;
                 }
                 return false;
             };
+
+            if (pi_frame.zero_copy != nullptr)
+            {
+                // outputs are already in the frame
+                link_.addDatagram(*pi_frame.zero_copy, Command::LWR, process, error);
+                continue;
+            }
+
+            uint8_t buffer[MAX_ETHERCAT_PAYLOAD_SIZE];
+            writeOutputs(pi_frame, buffer);
             link_.addDatagram(Command::LWR, pi_frame.address, buffer, pi_frame.size, process, error);
         }
         link_.finalizeDatagrams();
@@ -477,30 +1544,41 @@ namespace kickcat
 
 
     void Bus::sendLogicalReadWrite(std::function<void()> const& error)
+    {
+        sendLogicalReadWrite(error, ALL_GROUPS);
+    }
+
+
+    void Bus::sendLogicalReadWrite(std::function<void()> const& error, uint64_t groups)
     {
         for (auto const& pi_frame : pi_frames_)
         {
-            uint8_t buffer[MAX_ETHERCAT_PAYLOAD_SIZE];
-            for (auto const& output : pi_frame.outputs)
+            if (((groups >> pi_frame.group) & 1) == 0)
             {
-                std::memcpy(buffer + output.offset, output.iomap, output.size);
+                continue; // group not due
             }
 
-            auto process = [pi_frame](DatagramHeader const*, uint8_t const* data, uint16_t wkc)
+            auto process = [&pi_frame](DatagramHeader const*, uint8_t const* data, uint16_t wkc)
             {
-                if (wkc != pi_frame.inputs.size())
+                if (wkc != pi_frame.expectedReadWriteWKC())
                 {
                     DEBUG_PRINT("Invalid working counter\n");
                     return true;
                 }
 
-                for (auto& input : pi_frame.inputs)
-                {
-                    std::memcpy(input.iomap, data + input.offset, input.size);
-                }
+                readInputs(pi_frame, data);
                 return false;
             };
 
+            if (pi_frame.zero_copy != nullptr)
+            {
+                // outputs are already in the frame
+                link_.addDatagram(*pi_frame.zero_copy, Command::LRW, process, error);
+                continue;
+            }
+
+            uint8_t buffer[MAX_ETHERCAT_PAYLOAD_SIZE];
+            writeOutputs(pi_frame, buffer);
             link_.addDatagram(Command::LRW, pi_frame.address, buffer, pi_frame.size, process, error);
         }
         link_.finalizeDatagrams();
@@ -513,8 +1591,168 @@ namespace kickcat
     }
 
 
+    void Bus::setGroupPeriod(int32_t group, nanoseconds period)
+    {
+        if ((group < 0) or (group >= MAX_GROUPS))
+        {
+            THROW_ERROR("Invalid slave group");
+        }
+
+        if (groups_.size() <= static_cast<size_t>(group))
+        {
+            groups_.resize(group + 1);
+        }
+        groups_[group].period     = period;
+        groups_[group].next_read  = 0ns;
+        groups_[group].next_write = 0ns;
+    }
+
+
+    void Bus::setGroupOutputsRefresh(int32_t group, nanoseconds max_interval)
+    {
+        if ((group < 0) or (group >= MAX_GROUPS))
+        {
+            THROW_ERROR("Invalid slave group");
+        }
+
+        if (groups_.size() <= static_cast<size_t>(group))
+        {
+            groups_.resize(group + 1);
+        }
+        groups_[group].refresh = max_interval;
+    }
+
+
+    // helper: check if a group is due and schedule its next exchange
+    static bool isDue(nanoseconds period, nanoseconds now, nanoseconds& next)
+    {
+        if ((now < next) and ((next - now) <= period))
+        {
+            return false;
+        }
+
+        next += period;
+        if ((next <= now) or ((next - now) > period))
+        {
+            // first exchange or late: restart the period from now
+            // (same for a schedule ahead of more than a period: clock stepped back, or another time source)
+            next = now + period;
+        }
+        return true;
+    }
+
+
+    void Bus::sendDueLogicalRead(std::function<void()> const& error, nanoseconds now)
+    {
+        uint64_t groups = ALL_GROUPS;
+        for (size_t i = 0; i < groups_.size(); ++i)
+        {
+            if (not isDue(groups_[i].period, now, groups_[i].next_read))
+            {
+                groups &= ~(uint64_t{1} << i);
+            }
+        }
+        sendLogicalRead(error, groups);
+    }
+
+
+    void Bus::sendDueLogicalWrite(std::function<void()> const& error, nanoseconds now)
+    {
+        uint64_t groups = ALL_GROUPS;
+        for (size_t i = 0; i < groups_.size(); ++i)
+        {
+            if (not isDue(groups_[i].period, now, groups_[i].next_write))
+            {
+                groups &= ~(uint64_t{1} << i);
+            }
+        }
+        sendLogicalWrite(error, groups, now);
+    }
+
+
+    void Bus::sendDueLogicalReadWrite(std::function<void()> const& error, nanoseconds now)
+    {
+        uint64_t groups = ALL_GROUPS;
+        for (size_t i = 0; i < groups_.size(); ++i)
+        {
+            if (isDue(groups_[i].period, now, groups_[i].next_read))
+            {
+                groups_[i].next_write = groups_[i].next_read;
+            }
+            else
+            {
+                groups &= ~(uint64_t{1} << i);
+            }
+        }
+        sendLogicalReadWrite(error, groups);
+    }
+
+
+    Bus::PIConfig Bus::generatePIConfig(Slave const& slave, Slave::PIMapping const& mapping, SyncManagerType type)
+    {
+        // Get SyncManager configuration from SII
+        auto& sii_sm = slave.sii.syncManagers_[mapping.sync_manager];
+
+        PIConfig config;
+        SyncManager& sm = config.sm;
+        FMMU& fmmu = config.fmmu;
+        std::memset(&sm,   0, sizeof(SyncManager));
+        std::memset(&fmmu, 0, sizeof(FMMU));
+
+        config.sm_address   = static_cast<uint16_t>(reg::SYNC_MANAGER + mapping.sync_manager * 8);
+        config.fmmu_address = reg::FMMU;    // FMMU0 - outputs
+        sm.control = sii_sm->control_register;
+        fmmu.type  = 2;                     // write access
+        if (type == SyncManagerType::Input)
+        {
+            sm.control = 0x20;              // 3 buffers - read acces - PDI IRQ ON
+            fmmu.type  = 1;                 // read access
+            config.fmmu_address += 0x10;    // FMMU1 - inputs (slave to master)
+        }
+
+        sm.start_address = sii_sm->start_adress;
+        sm.length        = mapping.bsize;
+        sm.status        = 0x00; // RO register
+        sm.activate      = 0x01; // Sync Manager enable
+        sm.pdi_control   = 0x00; // RO register
+
+        fmmu.logical_address    = mapping.address;
+        fmmu.length             = mapping.bsize;
+        fmmu.logical_start_bit  = 0;   // we map every bits
+        fmmu.logical_stop_bit   = 0x7; // we map every bits
+        if (mapping.is_bit_packed)
+        {
+            // map only the used bits: the remaining ones of the byte belong to others slaves
+            fmmu.logical_start_bit = mapping.start_bit;
+            fmmu.logical_stop_bit  = static_cast<uint8_t>(mapping.start_bit + mapping.size - 1);
+        }
+        fmmu.physical_address   = sii_sm->start_adress;
+        fmmu.physical_start_bit = 0;
+        fmmu.activate           = 1;
+        return config;
+    }
+
+
+    FMMU Bus::generateMailboxStatusFMMU(int32_t bit) const
+    {
+        FMMU fmmu;
+        std::memset(&fmmu, 0, sizeof(FMMU));
+        fmmu.logical_address    = mailbox_status_address_ + bit / 8;
+        fmmu.length             = 1;
+        fmmu.logical_start_bit  = static_cast<uint8_t>(bit % 8);
+        fmmu.logical_stop_bit   = static_cast<uint8_t>(bit % 8);
+        fmmu.physical_address   = reg::SYNC_MANAGER_1 + reg::SM_STATS;
+        fmmu.physical_start_bit = 3;    // mailbox full
+        fmmu.type               = 1;    // read access
+        fmmu.activate           = 1;
+        return fmmu;
+    }
+
+
     void Bus::configureFMMUs()
     {
+        Tracer::Scope trace(tracer_, "configureFMMUs");
+
         auto prepareDatagrams = [this](Slave& slave, Slave::PIMapping& mapping, SyncManagerType type)
         {
             if (mapping.bsize == 0)
@@ -537,211 +1775,270 @@ namespace kickcat
                 return false;
             };
 
-            // Get SyncManager configuration from SII
-            auto& sii_sm = slave.sii.syncManagers_[mapping.sync_manager];
-
-            SyncManager sm;
-            FMMU fmmu;
-            std::memset(&sm,   0, sizeof(SyncManager));
-            std::memset(&fmmu, 0, sizeof(FMMU));
-
-            uint16_t targeted_fmmu = reg::FMMU; // FMMU0 - outputs
-            sm.control = sii_sm->control_register;
-            fmmu.type  = 2;                     // write access
-            if (type == SyncManagerType::Input)
-            {
-                sm.control = 0x20;              // 3 buffers - read acces - PDI IRQ ON
-                fmmu.type  = 1;                 // read access
-                targeted_fmmu += 0x10;          // FMMU1 - inputs (slave to master)
-            }
-
-            sm.start_address = sii_sm->start_adress;
-            sm.length        = mapping.bsize;
-            sm.status        = 0x00; // RO register
-            sm.activate      = 0x01; // Sync Manager enable
-            sm.pdi_control   = 0x00; // RO register
-            link_.addDatagram(Command::FPWR, createAddress(slave.address, reg::SYNC_MANAGER + mapping.sync_manager * 8), sm, process, error);
+            PIConfig config = generatePIConfig(slave, mapping, type);
+            SyncManager const& sm = config.sm;
+            FMMU const& fmmu = config.fmmu;
+            link_.addDatagram(Command::FPWR, createAddress(slave.address, config.sm_address), sm, process, error);
             DEBUG_PRINT("SM[%d] type %d - start address 0x%04x - length %d - flags: 0x%02x\n", mapping.sync_manager, type, sm.start_address, sm.length, sm.control);
 
-            fmmu.logical_address    = mapping.address;
-            fmmu.length             = mapping.bsize;
-            fmmu.logical_start_bit  = 0;   // we map every bits
-            fmmu.logical_stop_bit   = 0x7; // we map every bits
-            fmmu.physical_address   = sii_sm->start_adress;
-            fmmu.physical_start_bit = 0;
-            fmmu.activate           = 1;
-            link_.addDatagram(Command::FPWR, createAddress(slave.address, targeted_fmmu), fmmu, process, error);
+            link_.addDatagram(Command::FPWR, createAddress(slave.address, config.fmmu_address), fmmu, process, error);
             DEBUG_PRINT("slave %04x - size %d - ladd 0x%04x - paddr 0x%04x\n", slave.address, mapping.bsize, mapping.address, fmmu.physical_address);
         };
 
-        for (auto& slave : slaves_)
+        for (size_t i = 0; i < slaves_.size(); ++i)
+        {
+            prepareDatagrams(slaves_[i], slaves_[i].input,  SyncManagerType::Input);
+            prepareDatagrams(slaves_[i], slaves_[i].output, SyncManagerType::Output);
+
+            // up to 4 datagrams per slave: stay below the datagrams in flight limit on big networks
+            if ((i % 32) == 31)
+            {
+                link_.processDatagrams();
+            }
+        }
+
+        auto error = [](){ THROW_ERROR("Invalid working counter"); };
+        auto process = [](DatagramHeader const*, uint8_t const*, uint16_t wkc) { return wkc != 1; };
+        for (size_t i = 0; i < mailbox_status_slaves_.size(); ++i)
         {
-            prepareDatagrams(slave, slave.input,  SyncManagerType::Input);
-            prepareDatagrams(slave, slave.output, SyncManagerType::Output);
+            FMMU fmmu = generateMailboxStatusFMMU(static_cast<int32_t>(i));
+            link_.addDatagram(Command::FPWR, createAddress(mailbox_status_slaves_[i]->address, MAILBOX_STATUS_FMMU), fmmu, process, error);
+            if ((i % 128) == 127)
+            {
+                link_.processDatagrams();
+            }
         }
 
         link_.processDatagrams();
     }
 
 
-    bool Bus::areEepromReady()
+    void Bus::fetchEeprom(bool is_identity_only)
     {
-        bool ready = true;
-        auto process = [&ready](DatagramHeader const*, uint8_t const* data, uint16_t wkc)
+        Tracer::Scope trace(tracer_, "fetchEeprom");
+
+        // SII words to fetch, in 16 bits words: configuration checksum, slave info, mailbox info, eeprom size then the
+        // categories until the end one (or from the SII cache)
+        struct Range
         {
-            if (wkc != 1)
-            {
-                return true;
-            }
-            uint16_t answer = *reinterpret_cast<uint16_t const*>(data);
-            if (answer & 0x8000)
-            {
-                ready = false;
-            }
-            return false;
+            uint16_t begin;
+            uint16_t end;
         };
-
-        auto error = []()
+        static constexpr Range HEADER[] =
         {
-            THROW_ERROR("Error while fetching eeprom state");
+            {eeprom::ESC_CRC, eeprom::ESC_CRC + 1},
+            {eeprom::VENDOR_ID, eeprom::SERIAL_NUMBER + 2},
+            {eeprom::STANDARD_MAILBOX + eeprom::RECV_MBO_OFFSET, eeprom::MAILBOX_PROTOCOL + 2},
+            {eeprom::EEPROM_SIZE, eeprom::EEPROM_VERSION + 1},
         };
+        static constexpr int32_t HEADER_RANGES = sizeof(HEADER) / sizeof(Range);
+        static constexpr int32_t IDENTITY_RANGE = 1;
 
-        for (int i = 0; i < 10; ++i)
+        // EEPROM interface registers read in one datagram: the data are valid once the interface is not busy anymore
+        struct Answer
         {
-            sleep(tiny_wait);
-            for (auto& slave : slaves_)
-            {
-                link_.addDatagram(Command::FPRD, createAddress(slave.address, reg::EEPROM_CONTROL), nullptr, 2, process, error);
-            }
+            uint16_t control;
+            uint32_t address;
+            uint16_t data[4];
+        } __attribute__((__packed__));
+        constexpr uint16_t EEPROM_BUSY   = 0x8000;
+        constexpr uint16_t EEPROM_ERROR  = 0x2000;  // command error
+        constexpr uint16_t EEPROM_8BYTES = 0x0040;  // the ESC reads 8 bytes per request (4 otherwise)
 
-            ready = true; // rearm check
-            try
-            {
-                link_.processDatagrams();
-            }
-            catch (...)
-            {
-                return false;
-            }
+        // Each slave progresses on its own: a request is sent as soon as the previous data are read, so a slave with a
+        // short SII is done early and the slowest slave does not gate every word.
+        struct Fetch
+        {
+            Slave* slave;
+            std::array<uint16_t, eeprom::START_CATEGORY> header;
+            int32_t range;          // current header range, HEADER_RANGES when reading the categories
+            uint16_t address;       // next word to read
+            bool is_requested;
+            bool is_done;
+            bool is_cached;         // categories loaded from the SII cache
+            nanoseconds since;      // request time
+        };
 
-            if (ready)
+        int32_t first_range = is_identity_only ? IDENTITY_RANGE : 0;
+        int32_t last_range  = is_identity_only ? IDENTITY_RANGE + 1 : HEADER_RANGES;
+
+        std::vector<Fetch> fetches;
+        for (auto& slave : slaves_)
+        {
+            if (not is_identity_only)
             {
-                return ready;
+                slave.sii = Slave::SII{};   // fetched again: nothing shall be appended to the previous SII
             }
+            fetches.push_back({&slave, {}, first_range, HEADER[first_range].begin, false, false, false, 0ns});
         }
 
-        return false;
-    }
-
+        auto read32 = [](Fetch const& fetch, uint16_t address)
+        {
+            return fetch.header[address] | (static_cast<uint32_t>(fetch.header[address + 1]) << 16);
+        };
 
-    void Bus::readEeprom(uint16_t address, std::vector<Slave*> const& slaves, std::function<void(Slave&, uint32_t word)> apply)
-    {
-        // eeprom request
-        struct Request
+        auto applyIdentity = [&read32](Fetch& fetch)
         {
-            uint16_t command;
-            uint16_t addressLow;
-            uint16_t addressHigh;
-        } __attribute__((__packed__));
+            Slave& slave = *fetch.slave;
+            slave.vendor_id       = read32(fetch, eeprom::VENDOR_ID);
+            slave.product_code    = read32(fetch, eeprom::PRODUCT_CODE);
+            slave.revision_number = read32(fetch, eeprom::REVISION_NUMBER);
+            slave.serial_number   = read32(fetch, eeprom::SERIAL_NUMBER);
+        };
 
-        Request req;
+        auto applyHeader = [&read32, &applyIdentity](Fetch& fetch)
+        {
+            Slave& slave = *fetch.slave;
+
+            // General slave info
+            slave.eeprom_crc = fetch.header[eeprom::ESC_CRC];
+            applyIdentity(fetch);
+
+            // Mailbox info
+            slave.mailbox.recv_offset = fetch.header[eeprom::STANDARD_MAILBOX + eeprom::RECV_MBO_OFFSET];
+            slave.mailbox.recv_size   = fetch.header[eeprom::STANDARD_MAILBOX + eeprom::RECV_MBO_SIZE];
+            slave.mailbox.send_offset = fetch.header[eeprom::STANDARD_MAILBOX + eeprom::SEND_MBO_OFFSET];
+            slave.mailbox.send_size   = fetch.header[eeprom::STANDARD_MAILBOX + eeprom::SEND_MBO_SIZE];
+            slave.supported_mailbox = static_cast<eeprom::MailboxProtocol>(read32(fetch, eeprom::MAILBOX_PROTOCOL));
+
+            slave.eeprom_size = (fetch.header[eeprom::EEPROM_SIZE] & 0xFF) + 1;  // 0 means 1024 bits
+            slave.eeprom_size *= 128;                                           // Kibit to bytes
+            slave.eeprom_version = fetch.header[eeprom::EEPROM_VERSION];
+        };
 
-        // Request specific address
+        auto consume = [this, last_range, &applyIdentity, &applyHeader](Fetch& fetch, Answer const& answer)
         {
-            req = { eeprom::Command::READ, address, 0 };
-            uint16_t wkc = broadcastWrite(reg::EEPROM_CONTROL, &req, sizeof(req));
-            if (wkc != slaves_.size())
+            int32_t words = (answer.control & EEPROM_8BYTES) ? 4 : 2;
+            if (fetch.range < HEADER_RANGES)
             {
-                THROW_ERROR("Invalid working counter");
+                Range const& range = HEADER[fetch.range];
+                for (int32_t i = 0; (i < words) and (fetch.address < range.end); ++i)
+                {
+                    fetch.header[fetch.address] = answer.data[i];
+                    ++fetch.address;
+                }
+                if (fetch.address >= range.end)
+                {
+                    ++fetch.range;
+                    fetch.address = (fetch.range < HEADER_RANGES) ? HEADER[fetch.range].begin : eeprom::START_CATEGORY;
+                }
+                if (fetch.range == last_range)
+                {
+                    if (last_range != HEADER_RANGES)
+                    {
+                        applyIdentity(fetch);
+                        fetch.is_done = true;
+                        return;
+                    }
+                    applyHeader(fetch);
+                    if (sii_cache_.isEnabled() and sii_cache_.load(*fetch.slave))
+                    {
+                        fetch.is_cached = true;
+                        fetch.is_done = true;
+                    }
+                }
+                return;
             }
 
-            // wait for all eeprom to be ready
-            if (not areEepromReady())
+            for (int32_t i = 0; i < words; i += 2)
             {
-                THROW_ERROR("Timeout");
+                uint32_t word = answer.data[i] | (static_cast<uint32_t>(answer.data[i + 1]) << 16);
+                fetch.slave->sii.buffer.push_back(word);
+                fetch.address += 2;
+                if ((word >> 16) == eeprom::Category::End)
+                {
+                    fetch.is_done = true;
+                    return;
+                }
+                if ((fetch.address * sizeof(uint16_t)) >= fetch.slave->eeprom_size)
+                {
+                    DEBUG_PRINT("slave %04x: no SII end category\n", fetch.slave->address);
+                    fetch.is_done = true;   // whole EEPROM read
+                    return;
+                }
             }
-        }
+        };
 
-        // Read result
         auto error = []()
         {
             THROW_ERROR("Invalid working counter");
         };
 
-        for (auto& slave : slaves)
+        int32_t remaining = static_cast<int32_t>(fetches.size());
+        while (remaining > 0)
         {
-            auto process = [this, &slave, &apply](DatagramHeader const*, uint8_t const* data, uint16_t wkc)
+            for (auto& fetch : fetches)
             {
-                if (wkc != 1)
+                if (fetch.is_done)
                 {
-                    return true;
+                    continue;
                 }
-                uint32_t answer = *reinterpret_cast<uint32_t const*>(data);
-                apply(*slave, answer);
-                return false;
-            };
 
-            link_.addDatagram(Command::FPRD, createAddress(slave->address, reg::EEPROM_DATA), nullptr, 4, process, error);
-        }
-        link_.processDatagrams();
-    }
+                if (not fetch.is_requested)
+                {
+                    uint16_t request[3] = { eeprom::Command::READ, fetch.address, 0 };
+                    auto process = [](DatagramHeader const*, uint8_t const*, uint16_t wkc) { return wkc != 1; };
+                    link_.addDatagram(Command::FPWR, createAddress(fetch.slave->address, reg::EEPROM_CONTROL),
+                                      request, sizeof(request), process, error);
+                    fetch.is_requested = true;
+                    fetch.since = since_epoch();
+                    continue;
+                }
 
+                auto process = [this, &fetch, &remaining, &consume](DatagramHeader const*, uint8_t const* data, uint16_t wkc)
+                {
+                    if (wkc != 1)
+                    {
+                        return true;
+                    }
+                    Answer const* answer = reinterpret_cast<Answer const*>(data);
+                    if (answer->control & EEPROM_ERROR)
+                    {
+                        THROW_ERROR("EEPROM command error");
+                    }
+                    if (answer->control & EEPROM_BUSY)
+                    {
+                        if (elapsed_time(fetch.since) > big_wait)
+                        {
+                            THROW_ERROR("Timeout");
+                        }
+                        return false;
+                    }
 
-    void Bus::fetchEeprom()
-    {
-        std::vector<Slave*> slaves;
-        for (auto& slave : slaves_)
-        {
-            slaves.push_back(&slave);
+                    fetch.is_requested = false;
+                    if (tracer_ != nullptr)
+                    {
+                        char name[32];
+                        snprintf(name, sizeof(name), "readEeprom 0x%04x", fetch.address);
+                        tracer_->add(name, "eeprom", fetch.since, since_epoch(), Tracer::SLAVE + fetch.slave->address);
+                    }
+                    consume(fetch, *answer);
+                    if (fetch.is_done)
+                    {
+                        --remaining;
+                    }
+                    return false;
+                };
+                link_.addDatagram(Command::FPRD, createAddress(fetch.slave->address, reg::EEPROM_CONTROL),
+                                  nullptr, sizeof(Answer), process, error);
+            }
+            link_.processDatagrams();
         }
 
-        // General slave info
-        readEeprom(eeprom::VENDOR_ID,       slaves, [](Slave& s, uint32_t word) { s.vendor_id       = word; } );
-        readEeprom(eeprom::PRODUCT_CODE,    slaves, [](Slave& s, uint32_t word) { s.product_code    = word; } );
-        readEeprom(eeprom::REVISION_NUMBER, slaves, [](Slave& s, uint32_t word) { s.revision_number = word; } );
-        readEeprom(eeprom::SERIAL_NUMBER,   slaves, [](Slave& s, uint32_t word) { s.serial_number   = word; } );
-
-        // Mailbox info
-        readEeprom(eeprom::STANDARD_MAILBOX + eeprom::RECV_MBO_OFFSET, slaves,
-        [](Slave& s, uint32_t word) { s.mailbox.recv_offset = word; s.mailbox.recv_size = word >> 16; } );
-        readEeprom(eeprom::STANDARD_MAILBOX + eeprom::SEND_MBO_OFFSET, slaves,
-        [](Slave& s, uint32_t word) { s.mailbox.send_offset = word; s.mailbox.send_size = word >> 16; } );
-
-        readEeprom(eeprom::MAILBOX_PROTOCOL, slaves,
-        [](Slave& s, uint32_t word) { s.supported_mailbox = static_cast<eeprom::MailboxProtocol>(word); });
-
-        readEeprom(eeprom::EEPROM_SIZE, slaves,
-        [](Slave& s, uint32_t word)
+        if (is_identity_only)
         {
-            s.eeprom_size = (word & 0xFF) + 1;  // 0 means 1024 bits
-            s.eeprom_size *= 128;               // Kibit to bytes
-            s.eeprom_version = word >> 16;
-        });
+            return;
+        }
 
-        // Get SII section
-        int32_t pos = 0;
-        while (not slaves.empty())
+        for (auto& fetch : fetches)
         {
-            readEeprom(eeprom::START_CATEGORY + pos, slaves,
-            [](Slave& s, uint32_t word)
+            if (sii_cache_.isEnabled() and (not fetch.is_cached))
             {
-                s.sii.buffer.push_back(word);
-            });
-
-            pos += 2;
-
-            slaves.erase(std::remove_if(slaves.begin(), slaves.end(),
-            [](Slave* s)
-            {
-                return ((s->sii.buffer.back() >> 16) == eeprom::Category::End);
-            }),
-            slaves.end());
-        }
+                sii_cache_.store(*fetch.slave);
+            }
 
-        // Parse SII
-        for (auto& slave : slaves_)
-        {
-            slave.parseSII();
+            // Parse SII
+            fetch.slave->parseSII();
         }
     }
 
@@ -758,6 +2055,26 @@ namespace kickcat
             return ((state & 0x08) == 0x08);
         };
 
+        if (not mailbox_status_slaves_.empty())
+        {
+            // every SM1 status from the mapped area in one datagram
+            auto process = [this](DatagramHeader const*, uint8_t const* data, uint16_t wkc)
+            {
+                if (wkc != mailbox_status_slaves_.size())
+                {
+                    DEBUG_PRINT("Invalid working counter\n");
+                    return false;   // stable values
+                }
+                for (size_t i = 0; i < mailbox_status_slaves_.size(); ++i)
+                {
+                    mailbox_status_slaves_[i]->mailbox.can_read = (data[i / 8] >> (i % 8)) & 1;
+                }
+                return false;
+            };
+            uint16_t size = static_cast<uint16_t>((mailbox_status_slaves_.size() + 7) / 8);
+            link_.addDatagram(Command::LRD, mailbox_status_address_, nullptr, size, process, error);
+        }
+
         for (auto& slave : slaves_)
         {
             auto process_write = [&slave, isFull](DatagramHeader const*, uint8_t const* state, uint16_t wkc)
@@ -776,6 +2093,15 @@ namespace kickcat
             {
                 continue;
             }
+            if (slave.is_mailbox_status_mapped)
+            {
+                // mapped status: free space is only needed to send a message
+                if (not slave.mailbox.to_send.empty())
+                {
+                    link_.addDatagram(Command::FPRD, createAddress(slave.address, reg::SYNC_MANAGER_0 + reg::SM_STATS), nullptr, 1, process_write, error);
+                }
+                continue;
+            }
             link_.addDatagram(Command::FPRD, createAddress(slave.address, reg::SYNC_MANAGER_0 + reg::SM_STATS), nullptr, 1, process_write, error);
             link_.addDatagram(Command::FPRD, createAddress(slave.address, reg::SYNC_MANAGER_1 + reg::SM_STATS), nullptr, 1, process_read,  error);
         }
@@ -808,6 +2134,7 @@ namespace kickcat
                 // send one waiting message
                 auto message = slave.mailbox.send();
                 link_.addDatagram(Command::FPWR, createAddress(slave.address, slave.mailbox.recv_offset), message->data(), message->size(), process, error);
+                slave.mailbox.can_write = false;    // the mailbox is full once written, until the next check
             }
         }
         link_.finalizeDatagrams();
@@ -825,6 +2152,7 @@ namespace kickcat
                     DEBUG_PRINT("Invalid working counter for slave %d\n", slave.address);
                     return true;
                 }
+                slave.mailbox.can_read = false;  // the mailbox is empty once read, until the next check
 
                 if (not slave.mailbox.receive(data))
                 {
@@ -0,0 +1,256 @@
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "BusConfig.h"
+#include "Error.h"
+
+namespace kickcat
+{
+    BusConfig BusConfig::load(std::string const& path)
+    {
+        std::ifstream file(path);
+        if (not file)
+        {
+            THROW_ERROR("Cannot open the bus configuration");
+        }
+
+        BusConfig config;
+        std::string line;
+        int32_t line_number = 0;
+        while (std::getline(file, line))
+        {
+            ++line_number;
+            line = line.substr(0, line.find('#'));
+
+            std::istringstream items(line);
+            std::string item;
+            if (not (items >> item))
+            {
+                continue; // empty line or comment
+            }
+
+            // numbers of the line, in decimal or hexadecimal
+            auto numbers = [&](std::size_t count)
+            {
+                std::vector<uint32_t> values;
+                std::string token;
+                while (items >> token)
+                {
+                    std::size_t end;
+                    values.push_back(static_cast<uint32_t>(std::stoul(token, &end, 0)));
+                    if (end != token.size())
+                    {
+                        THROW_ERROR_CODE("Invalid number in the bus configuration", line_number);
+                    }
+                }
+                if (values.size() != count)
+                {
+                    THROW_ERROR_CODE("Invalid item size in the bus configuration", line_number);
+                }
+                return values;
+            };
+
+            try
+            {
+                if (item == "slave")
+                {
+                    auto v = numbers(4);
+                    config.slaves.push_back({});
+                    SlaveConfig& slave = config.slaves.back();
+                    slave.vendor_id       = v[0];
+                    slave.product_code    = v[1];
+                    slave.revision_number = v[2];
+                    slave.serial_number   = v[3];
+                    continue;
+                }
+
+                if (config.slaves.empty())
+                {
+                    THROW_ERROR_CODE("Bus configuration item without slave", line_number);
+                }
+                SlaveConfig& slave = config.slaves.back();
+
+                if (item == "mailbox")
+                {
+                    auto v = numbers(5);
+                    slave.recv_offset       = static_cast<uint16_t>(v[0]);
+                    slave.recv_size         = static_cast<uint16_t>(v[1]);
+                    slave.send_offset       = static_cast<uint16_t>(v[2]);
+                    slave.send_size         = static_cast<uint16_t>(v[3]);
+                    slave.supported_mailbox = static_cast<uint16_t>(v[4]);
+                }
+                else if (item == "sm")
+                {
+                    auto v = numbers(6);
+                    slave.sync_managers.push_back({static_cast<uint16_t>(v[0]), static_cast<uint16_t>(v[1]),
+                                                   static_cast<uint8_t>(v[2]),  static_cast<uint8_t>(v[3]),
+                                                   static_cast<uint8_t>(v[4]),  static_cast<uint8_t>(v[5])});
+                }
+                else if ((item == "input") or (item == "output"))
+                {
+                    auto v = numbers(2);
+                    SlaveConfig::Mapping& mapping = (item == "input") ? slave.input : slave.output;
+                    mapping.size         = static_cast<int32_t>(v[0]);
+                    mapping.sync_manager = static_cast<int32_t>(v[1]);
+                }
+                else if (item == "entry")
+                {
+                    std::string direction;
+                    items >> direction;
+                    if ((direction != "input") and (direction != "output"))
+                    {
+                        THROW_ERROR_CODE("Invalid entry direction in the bus configuration", line_number);
+                    }
+                    auto v = numbers(3);
+                    SlaveConfig::Mapping& mapping = (direction == "input") ? slave.input : slave.output;
+                    mapping.entries.push_back({static_cast<uint16_t>(v[0]), static_cast<uint8_t>(v[1]), static_cast<uint8_t>(v[2])});
+                }
+                else if (item == "sdo")
+                {
+                    auto v = numbers(4);
+                    if ((v[2] == 0) or (v[2] > 4))
+                    {
+                        THROW_ERROR_CODE("Invalid SDO size in the bus configuration", line_number);
+                    }
+                    slave.sdos.push_back({static_cast<uint16_t>(v[0]), static_cast<uint8_t>(v[1]), v[2], v[3]});
+                }
+                else
+                {
+                    THROW_ERROR_CODE("Unknown item in the bus configuration", line_number);
+                }
+            }
+            catch (std::logic_error const&) // std::stoul() failure
+            {
+                THROW_ERROR_CODE("Invalid number in the bus configuration", line_number);
+            }
+        }
+
+        return config;
+    }
+
+
+    void BusConfig::save(std::string const& path) const
+    {
+        FILE* file = fopen(path.c_str(), "w");
+        if (file == nullptr)
+        {
+            THROW_SYSTEM_ERROR("fopen()");
+        }
+
+        fprintf(file, "# KickCAT bus configuration: %zu slaves\n", slaves.size());
+        for (std::size_t i = 0; i < slaves.size(); ++i)
+        {
+            SlaveConfig const& slave = slaves[i];
+            fprintf(file, "\n# position %zu\n", i);
+            fprintf(file, "slave   0x%08" PRIx32 " 0x%08" PRIx32 " 0x%08" PRIx32 " 0x%08" PRIx32 "\n",
+                    slave.vendor_id, slave.product_code, slave.revision_number, slave.serial_number);
+            fprintf(file, "mailbox 0x%04x %u 0x%04x %u 0x%04x\n",
+                    slave.recv_offset, slave.recv_size, slave.send_offset, slave.send_size, slave.supported_mailbox);
+            for (auto const& sm : slave.sync_managers)
+            {
+                fprintf(file, "sm      0x%04x %u 0x%02x 0x%02x %u %u\n",
+                        sm.start_adress, sm.length, sm.control_register, sm.status_register, sm.enable, sm.type);
+            }
+            for (auto const& [name, mapping] : {std::make_pair("input", &slave.input), std::make_pair("output", &slave.output)})
+            {
+                fprintf(file, "%-7s %" PRId32 " %" PRId32 "\n", name, mapping->size, mapping->sync_manager);
+                for (auto const& entry : mapping->entries)
+                {
+                    fprintf(file, "entry   %-6s 0x%04x %u %u\n", name, entry.index, entry.subindex, entry.bit_size);
+                }
+            }
+            for (auto const& sdo : slave.sdos)
+            {
+                fprintf(file, "sdo     0x%04x %u %" PRIu32 " 0x%" PRIx32 "\n", sdo.index, sdo.subindex, sdo.size, sdo.value);
+            }
+        }
+
+        if (fclose(file) != 0)
+        {
+            THROW_SYSTEM_ERROR("fclose()");
+        }
+    }
+
+
+    std::vector<SlaveConfig::SDO> SlaveConfig::remapSDOs(uint16_t assignment, uint16_t pdo, std::vector<Slave::PDOObject> const& objects)
+    {
+        // disable the assignment and the PDO, write the entries, then enable them again
+        std::vector<SDO> sdos;
+        sdos.push_back({assignment, 0, 1, 0});
+        if (objects.empty())
+        {
+            return sdos; // nothing to exchange on this SyncManager
+        }
+
+        sdos.push_back({pdo, 0, 1, 0});
+        uint8_t count = 0;
+        for (auto const& object : objects)
+        {
+            ++count;
+            uint32_t entry = (uint32_t{object.index} << 16) | (uint32_t{object.subindex} << 8) | object.bit_size;
+            sdos.push_back({pdo, count, 4, entry});
+        }
+        sdos.push_back({pdo, 0, 1, count});
+
+        sdos.push_back({assignment, 1, 2, pdo});
+        sdos.push_back({assignment, 0, 1, 1});
+        return sdos;
+    }
+
+
+    BusConfig BusConfig::fromSlaves(std::vector<Slave> const& slaves)
+    {
+        BusConfig config;
+        for (auto const& slave : slaves)
+        {
+            SlaveConfig expected{};
+            expected.vendor_id         = slave.vendor_id;
+            expected.product_code      = slave.product_code;
+            expected.revision_number   = slave.revision_number;
+            expected.serial_number     = slave.serial_number;
+            expected.recv_offset       = slave.mailbox.recv_offset;
+            expected.recv_size         = slave.mailbox.recv_size;
+            expected.send_offset       = slave.mailbox.send_offset;
+            expected.send_size         = slave.mailbox.send_size;
+            expected.supported_mailbox = slave.supported_mailbox;
+
+            for (auto const* sm : slave.sii.syncManagers_)
+            {
+                expected.sync_managers.push_back(*sm);
+            }
+
+            auto describe = [](Slave::PIMapping const& mapping, std::vector<Slave::PIEntry> const& entries, SlaveConfig::Mapping& out)
+            {
+                out.size = mapping.size;
+                out.sync_manager = mapping.sync_manager;
+                for (auto const& entry : entries)
+                {
+                    out.entries.push_back({entry.index, entry.subindex, static_cast<uint8_t>(entry.bit_size)});
+                }
+            };
+            describe(slave.input,  slave.input_entries,  expected.input);
+            describe(slave.output, slave.output_entries, expected.output);
+
+            if (slave.is_pdo_remapped)
+            {
+                // same sequence as the mapping creation: only the SyncManagers the slave has are remapped
+                auto remap = [&expected](Slave::PIMapping const& mapping, uint16_t pdo, std::vector<Slave::PDOObject> const& objects)
+                {
+                    if (mapping.sync_manager < 0)
+                    {
+                        return;
+                    }
+                    auto sdos = SlaveConfig::remapSDOs(static_cast<uint16_t>(CoE::SM_CHANNEL + mapping.sync_manager), pdo, objects);
+                    expected.sdos.insert(expected.sdos.end(), sdos.begin(), sdos.end());
+                };
+                remap(slave.output, CoE::RxPDO_MAPPING, slave.rx_pdo_request);
+                remap(slave.input,  CoE::TxPDO_MAPPING, slave.tx_pdo_request);
+            }
+
+            config.slaves.push_back(std::move(expected));
+        }
+        return config;
+    }
+}
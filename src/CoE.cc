@@ -1,3 +1,4 @@
+#include <cstdio>
 #include <cstring>
 
 #include "Bus.h"
@@ -23,6 +24,179 @@ namespace kickcat
     }
 
 
+    void Bus::SDOChain::wait(std::shared_ptr<AbstractMessage> message, uint16_t object_index, uint8_t object_subindex,
+                             std::function<void()> done)
+    {
+        index = object_index;
+        subindex = object_subindex;
+        pending = std::move(message);
+        on_done = std::move(done);
+        since = since_epoch();
+    }
+
+
+    void Bus::SDOChain::flush()
+    {
+        steps.insert(steps.begin(), scheduled.begin(), scheduled.end());
+        scheduled.clear();
+    }
+
+
+    void Bus::processSDOChains(std::vector<SDOChain>& chains, nanoseconds timeout)
+    {
+        auto error_callback = [](){ THROW_ERROR("error while checking mailboxes"); };
+
+        try
+        {
+            bool running = true;
+            while (running)
+            {
+                running = false;
+                for (auto& chain : chains)
+                {
+                    if (chain.pending)
+                    {
+                        if (chain.pending->status() == MessageStatus::RUNNING)
+                        {
+                            if (elapsed_time(chain.since) > timeout)
+                            {
+                                THROW_ERROR("Timeout");
+                            }
+                            running = true;
+                            continue;
+                        }
+
+                        if (tracer_ != nullptr)
+                        {
+                            char name[32];
+                            snprintf(name, sizeof(name), "SDO 0x%04x:%02x", chain.index, chain.subindex);
+                            tracer_->add(name, "coe", chain.since, since_epoch(), Tracer::SLAVE + chain.slave->address);
+                        }
+
+                        auto on_done = std::move(chain.on_done);
+                        chain.pending = nullptr;
+                        chain.on_done = nullptr;
+                        if (on_done)
+                        {
+                            on_done();
+                        }
+                    }
+                    chain.flush();
+
+                    // start the next message of this slave
+                    while ((chain.pending == nullptr) and (not chain.steps.empty()))
+                    {
+                        auto step = std::move(chain.steps.front());
+                        chain.steps.pop_front();
+                        step(chain);
+                        chain.flush();
+                    }
+
+                    if (chain.pending)
+                    {
+                        running = true;
+                    }
+                }
+
+                if (running)
+                {
+                    // one mailbox round for every slave
+                    checkMailboxes(error_callback);
+                    processMessages(error_callback);
+                    sleep(tiny_wait);
+                }
+            }
+        }
+        catch (...)
+        {
+            // pending messages write their answer in the chains data: they shall not outlive them
+            for (auto& chain : chains)
+            {
+                if (chain.pending)
+                {
+                    chain.slave->mailbox.cancel(chain.pending, MessageStatus::TIMEDOUT);
+                }
+            }
+            throw;
+        }
+    }
+
+
+    void Bus::chainReadSDO(SDOChain& chain, uint16_t index, void* data, uint32_t capacity,
+                           std::function<void(SDOChain&, uint32_t size)> on_done)
+    {
+        struct Context
+        {
+            int32_t subindexes{0};
+            uint32_t size;
+            uint32_t already_read{0};
+        };
+        auto context = std::make_shared<Context>();
+
+        // subindex 0: number of subindexes to read
+        chain.then([index, data, capacity, on_done, context](SDOChain& current)
+        {
+            context->size = sizeof(context->subindexes);
+            auto sdo = current.slave->mailbox.createSDO(index, 0, false, CoE::SDO::request::UPLOAD, &context->subindexes, &context->size);
+            current.wait(sdo, index, 0, [&current, index, data, capacity, on_done, context]()
+            {
+                for (int32_t i = 1; i <= context->subindexes; ++i)
+                {
+                    current.then([index, i, data, capacity, context](SDOChain& owner)
+                    {
+                        context->size = capacity - context->already_read;
+                        if (context->size == 0)
+                        {
+                            THROW_ERROR("Error while reading SDO - client buffer too small");
+                        }
+
+                        uint8_t* pos = reinterpret_cast<uint8_t*>(data) + context->already_read;
+                        auto entry_sdo = owner.slave->mailbox.createSDO(index, static_cast<uint8_t>(i), false, CoE::SDO::request::UPLOAD, pos, &context->size);
+                        owner.wait(entry_sdo, index, static_cast<uint8_t>(i), [entry_sdo, context]()
+                        {
+                            if (entry_sdo->status() != MessageStatus::SUCCESS)
+                            {
+                                THROW_ERROR("Error while reading SDO - emulated complete access");
+                            }
+                            context->already_read += context->size;
+                        });
+                    });
+                }
+
+                current.then([on_done, context](SDOChain& owner)
+                {
+                    on_done(owner, context->already_read);
+                });
+            });
+        });
+    }
+
+
+    void Bus::chainWriteSDO(SDOChain& chain, uint16_t index, uint8_t subindex, uint32_t value, uint32_t size)
+    {
+        struct Context
+        {
+            uint32_t data;          // little endian: the first 'size' bytes are sent
+            uint32_t data_size;
+        };
+        auto context = std::make_shared<Context>(Context{value, size});
+
+        // the message refers to the context: it lives with the chain until the message is finished
+        chain.then([index, subindex, context](SDOChain& current)
+        {
+            auto message = current.slave->mailbox.createSDO(index, subindex, false, CoE::SDO::request::DOWNLOAD, &context->data, &context->data_size);
+            current.wait(message, index, subindex, [message, index, subindex, context]()
+            {
+                // the slave keeps its previous configuration: the next steps would rely on a wrong one
+                if (message->status() != MessageStatus::SUCCESS)
+                {
+                    throw SDOError{LOCATION ": SDO write refused", static_cast<int32_t>(message->status()), index, subindex};
+                }
+            });
+        });
+    }
+
+
     void Bus::readSDO(Slave& slave, uint16_t index, uint8_t subindex, Access CA, void* data, uint32_t* data_size, nanoseconds timeout)
     {
         if ((CA == Access::PARTIAL) or (CA == Access::COMPLETE))
@@ -33,41 +207,130 @@ namespace kickcat
         }
 
         // emulate complete access
-        int32_t object_size = 0;
-        uint32_t size = sizeof(object_size);
-        auto sdo = slave.mailbox.createSDO(index, 0, false, CoE::SDO::request::UPLOAD, &object_size, &size);
+        std::vector<SDOChain> chains(1);
+        chains[0].slave = &slave;
+        chainReadSDO(chains[0], index, data, *data_size, [data_size](SDOChain&, uint32_t size) { *data_size = size; });
+        processSDOChains(chains, timeout);
+    }
+
+
+    void Bus::writeSDO(Slave& slave, uint16_t index, uint8_t subindex, bool CA, void* data, uint32_t data_size, nanoseconds timeout)
+    {
+        auto sdo = slave.mailbox.createSDO(index, subindex, CA, CoE::SDO::request::DOWNLOAD, data, &data_size);
         waitForMessage(sdo, timeout);
+    }
+
+
+    std::shared_ptr<Bus::SDORequest const> Bus::asyncReadSDO(Slave& slave, uint16_t index, uint8_t subindex, uint32_t capacity,
+                                                             nanoseconds timeout, SDOCallback callback)
+    {
+        auto request = std::make_shared<SDORequest>();
+        request->slave = &slave;
+        request->index = index;
+        request->subindex = subindex;
+        request->data.resize(capacity);
+        request->size = capacity;
+        request->since = since_epoch();
+        request->deadline = request->since + timeout;
+        request->callback = std::move(callback);
+        request->message = slave.mailbox.createSDO(index, subindex, false, CoE::SDO::request::UPLOAD, request->data.data(), &request->size);
+        sdo_requests_.push_back(request);
+        return request;
+    }
 
-        uint8_t* pos = reinterpret_cast<uint8_t*>(data);
-        size = *data_size;
-        uint32_t already_read = 0;
-        for (uint8_t i = 1; i <= object_size; ++i)
+
+    std::shared_ptr<Bus::SDORequest const> Bus::asyncWriteSDO(Slave& slave, uint16_t index, uint8_t subindex, void const* data, uint32_t data_size,
+                                                              nanoseconds timeout, SDOCallback callback)
+    {
+        auto request = std::make_shared<SDORequest>();
+        request->slave = &slave;
+        request->index = index;
+        request->subindex = subindex;
+        request->data.assign(static_cast<uint8_t const*>(data), static_cast<uint8_t const*>(data) + data_size);
+        request->size = data_size;
+        request->since = since_epoch();
+        request->deadline = request->since + timeout;
+        request->callback = std::move(callback);
+        request->message = slave.mailbox.createSDO(index, subindex, false, CoE::SDO::request::DOWNLOAD, request->data.data(), &request->size);
+        sdo_requests_.push_back(request);
+        return request;
+    }
+
+
+    void Bus::processSDORequests(nanoseconds now)
+    {
+        // requests finished by this call: callbacks are called once the list is consistent (a callback may queue a request)
+        std::vector<std::shared_ptr<SDORequest>> finished;
+        for (auto it = sdo_requests_.begin(); it != sdo_requests_.end();)
         {
-            size = *data_size - already_read;
-            if (size == 0)
+            auto& request = *it;
+            if ((not request->isDone()) and (now > request->deadline))
             {
-                THROW_ERROR("Error while reading SDO - client buffer too small");
+                // the request data is released with it: no late answer shall reach it
+                request->slave->mailbox.cancel(request->message, MessageStatus::TIMEDOUT);
+            }
+            if (not request->isDone())
+            {
+                ++it;
+                continue;
             }
 
-            sdo = slave.mailbox.createSDO(index, i, false, CoE::SDO::request::UPLOAD, pos, &size);
-            waitForMessage(sdo, timeout);
+            if (request->status() == MessageStatus::SUCCESS)
+            {
+                request->data.resize(request->size);
+            }
+            finished.push_back(std::move(request));
+            it = sdo_requests_.erase(it);
+        }
 
-            if (sdo->status() != MessageStatus::SUCCESS)
+        for (auto& request : finished)
+        {
+            if (tracer_ != nullptr)
+            {
+                char name[32];
+                snprintf(name, sizeof(name), "SDO 0x%04x:%02x", request->index, request->subindex);
+                tracer_->add(name, "coe", request->since, now, Tracer::SLAVE + request->slave->address);
+            }
+            if (request->callback)
+            {
+                request->callback(*request);
+            }
+        }
+    }
+
+
+    void Bus::cancelSDORequests()
+    {
+        for (auto& request : sdo_requests_)
+        {
+            if (not request->isDone())
             {
-                THROW_ERROR("Error while reading SDO - emulated complete access");
+                request->slave->mailbox.cancel(request->message, MessageStatus::TIMEDOUT);
             }
+        }
+    }
 
-            pos += size;
-            already_read += size;
+
+    void Bus::requestPDOMapping(Slave& slave, std::vector<Slave::PDOObject> const& rx_pdo, std::vector<Slave::PDOObject> const& tx_pdo)
+    {
+        // a PDO mapping object holds up to 254 entries
+        if ((rx_pdo.size() > 254) or (tx_pdo.size() > 254))
+        {
+            THROW_ERROR("Too many objects in the PDO mapping");
         }
 
-        *data_size = already_read;
+        slave.is_pdo_remapped = true;
+        slave.rx_pdo_request = rx_pdo;
+        slave.tx_pdo_request = tx_pdo;
     }
 
 
-    void Bus::writeSDO(Slave& slave, uint16_t index, uint8_t subindex, bool CA, void* data, uint32_t data_size, nanoseconds timeout)
+    void Bus::writePDOMapping(SDOChain& chain, uint16_t assignment, uint16_t pdo, std::vector<Slave::PDOObject> const& objects)
     {
-        auto sdo = slave.mailbox.createSDO(index, subindex, CA, CoE::SDO::request::DOWNLOAD, data, &data_size);
-        waitForMessage(sdo, timeout);
+        // same sequence as the one saved in a bus configuration
+        for (auto const& sdo : SlaveConfig::remapSDOs(assignment, pdo, objects))
+        {
+            chainWriteSDO(chain, sdo.index, sdo.subindex, sdo.value, sdo.size);
+        }
     }
 }
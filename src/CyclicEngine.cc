@@ -0,0 +1,198 @@
+#include <cerrno>
+#include <sched.h>
+
+#include "CyclicEngine.h"
+
+namespace kickcat
+{
+    CyclicEngine::CyclicEngine(Bus& bus, nanoseconds period)
+        : bus_(bus)
+        , period_(period)
+        , late_threshold_(period / 10)
+        , error_([this](){ ++stats_.errors; })
+    {
+        if (period <= 0ns)
+        {
+            THROW_ERROR("Invalid cycle period");
+        }
+    }
+
+
+    void CyclicEngine::setRealTime(int32_t priority, int32_t cpu)
+    {
+        if ((priority < 0) or (priority > sched_get_priority_max(SCHED_FIFO)))
+        {
+            THROW_ERROR("Invalid real time priority");
+        }
+        priority_ = priority;
+        cpu_ = cpu;
+    }
+
+
+    void CyclicEngine::setPipelined(bool enable, nanoseconds phase)
+    {
+        if ((phase < 0ns) or (phase >= period_))
+        {
+            THROW_ERROR("Invalid pipeline phase");
+        }
+        is_pipelined_ = enable;
+        phase_ = phase;
+        pending_ = Timestamps{};
+    }
+
+
+    void CyclicEngine::setupRealTime()
+    {
+        if (cpu_ >= 0)
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu_, &set);
+            if (sched_setaffinity(0, sizeof(set), &set) < 0)
+            {
+                THROW_SYSTEM_ERROR("sched_setaffinity()");
+            }
+        }
+
+        if (priority_ > 0)
+        {
+            sched_param param{};
+            param.sched_priority = priority_;
+            if (sched_setscheduler(0, SCHED_FIFO, &param) < 0)
+            {
+                THROW_SYSTEM_ERROR("sched_setscheduler()");
+            }
+        }
+    }
+
+
+    void CyclicEngine::run(int64_t cycles)
+    {
+        setupRealTime();
+
+        is_running_ = true;
+        deadline_ = monotonic_time() + period_;
+        for (int64_t i = 0; (cycles < 0) or (i < cycles); ++i)
+        {
+            if (not is_running_)
+            {
+                break;
+            }
+            cycle();
+        }
+        is_running_ = false;
+
+        if (is_pipelined_)
+        {
+            bus_.processAwaitingFrames(); // last outputs answer
+        }
+    }
+
+
+    void CyclicEngine::cycle()
+    {
+        sleep_until(deadline_);
+
+        nanoseconds wakeup = monotonic_time();
+        nanoseconds latency = wakeup - deadline_;
+        stats_.max_wakeup_latency = std::max(stats_.max_wakeup_latency, latency);
+        if (latency > late_threshold_)
+        {
+            ++stats_.late_wakeups;
+            stats_.last_late_wakeup = wakeup;
+        }
+
+        Timestamps current{deadline_, wakeup, 0ns, 0ns};
+        if (pre_send_)
+        {
+            pre_send_();
+        }
+        bus_.sendStateRequests(error_);     // asynchronous state transitions progress with the cycle
+        sendMailboxes();
+
+        // groups are scheduled on the cycle deadline: monotonic, and steady from one cycle to the next
+        if (is_pipelined_)
+        {
+            bus_.sendDueLogicalRead(error_, deadline_);
+            bus_.processAwaitingFrames();       // previous outputs answer is processed too
+            current.inputs = monotonic_time();
+            receiveMailboxes();
+            if (post_receive_)
+            {
+                post_receive_();
+            }
+
+            if (phase_ > 0ns)
+            {
+                sleep_until(deadline_ + phase_);
+            }
+            bus_.sendDueLogicalWrite(error_, deadline_);    // answer processed with the next inputs
+            current.outputs = monotonic_time();
+            outputsSent(current);
+        }
+        else
+        {
+            bus_.sendDueLogicalReadWrite(error_, deadline_);
+            if (pending_.inputs > 0ns)
+            {
+                // outputs computed from the previous inputs are on the wire
+                pending_.outputs = monotonic_time();
+                outputsSent(pending_);
+            }
+            bus_.processAwaitingFrames();
+            current.inputs = monotonic_time();
+            receiveMailboxes();
+            if (post_receive_)
+            {
+                post_receive_();
+            }
+            pending_ = current;
+        }
+        ++stats_.cycles;
+
+        nanoseconds end = monotonic_time();
+        stats_.max_cycle_time = std::max(stats_.max_cycle_time, end - deadline_);
+
+        deadline_ += period_;
+        if (end > deadline_)
+        {
+            ++stats_.overruns;
+            stats_.last_overrun = end;
+            while (deadline_ <= end)
+            {
+                deadline_ += period_; // skip the missed deadlines
+            }
+        }
+    }
+
+
+    void CyclicEngine::sendMailboxes()
+    {
+        if (not is_mailboxes_enabled_)
+        {
+            return;
+        }
+
+        // the states read by the previous cycle are up to date: an answer is read before the next request is written
+        // (a slave keeps its answer until read), and the states are checked after both
+        bus_.sendReadMessages(error_);
+        bus_.sendWriteMessages(error_);
+        bus_.sendMailboxesChecks(error_);
+    }
+
+
+    void CyclicEngine::receiveMailboxes()
+    {
+        if (is_mailboxes_enabled_)
+        {
+            bus_.processSDORequests();
+        }
+    }
+
+
+    void CyclicEngine::outputsSent(Timestamps const& inputs_cycle)
+    {
+        timestamps_ = inputs_cycle;
+        stats_.max_io_latency = std::max(stats_.max_io_latency, timestamps_.latency());
+    }
+}
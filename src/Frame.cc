@@ -178,7 +178,7 @@ namespace kickcat
     }
 
 
-    void Frame::read(std::shared_ptr<AbstractSocket> socket)
+    void Frame::read(std::shared_ptr<AbstractSocket> const& socket)
     {
         int32_t read = socket->read(frame_.data(), frame_.size());
         if (read < 0)
@@ -207,7 +207,7 @@ namespace kickcat
     }
 
 
-    void Frame::write(std::shared_ptr<AbstractSocket> socket)
+    void Frame::write(std::shared_ptr<AbstractSocket> const& socket)
     {
         int32_t toWrite = finalize();
         int32_t written = socket->write(frame_.data(), toWrite);
@@ -1,9 +1,34 @@
+#include <cstring>
+
 #include "Link.h"
 #include "AbstractSocket.h"
 #include "Time.h"
 
 namespace kickcat
 {
+    ZeroCopyFrame::ZeroCopyFrame(uint32_t address, uint16_t data_size)
+        : address_{address}
+        , data_size_{data_size}
+    {
+        // Prepare the datagram once: only the index and the command will change from one cycle to another
+        Frame frame;
+        frame.addDatagram(0, Command::LRD, address, nullptr, data_size);
+        tx_size_ = frame.finalize();
+        std::memcpy(tx_.data(), frame.data(), tx_size_);
+    }
+
+
+    void ZeroCopyFrame::swap(uint8_t const* data)
+    {
+        uint8_t* back_payload = back().data() + PAYLOAD_OFFSET;
+        if (data != back_payload)
+        {
+            std::memcpy(back_payload, data, data_size_);
+        }
+        front_ = 1 - front_;
+    }
+
+
     Link::Link(std::shared_ptr<AbstractSocket> socket)
         : socket_(socket)
     {
@@ -13,15 +38,28 @@ namespace kickcat
 
     void Link::writeThenRead(Frame& frame)
     {
+        nanoseconds start = (tracer_ != nullptr) ? since_epoch() : 0ns;
         frame.write(socket_);
+        ++sent_frames_;
+        ++round_trips_;
         frame.read(socket_);
+        if (tracer_ != nullptr)
+        {
+            tracer_->add("frame", "link", start, since_epoch(), Tracer::LINK);
+        }
     }
 
 
     void Link::sendFrame()
     {
+        if (tracer_ != nullptr)
+        {
+            sent_at_[sent_frame_] = since_epoch();
+        }
         frame_.write(socket_);
+        destinations_[sent_frame_] = nullptr;
         ++sent_frame_;
+        ++sent_frames_;
     }
 
 
@@ -53,6 +91,60 @@ namespace kickcat
     }
 
 
+    void Link::addDatagram(ZeroCopyFrame& frame, enum Command command,
+                           std::function<bool(DatagramHeader const*, uint8_t const* data, uint16_t wkc)> const& process,
+                           std::function<void()> const& error)
+    {
+        if (index_queue_ == static_cast<uint8_t>(index_head_ + 1))
+        {
+            THROW_ERROR("Too many datagrams in flight. Max is 255");
+        }
+
+        // keep sending order: pending datagrams go first
+        finalizeDatagrams();
+
+        DatagramHeader* header = reinterpret_cast<DatagramHeader*>(frame.tx_.data() + sizeof(EthernetHeader) + sizeof(EthercatHeader));
+        header->index   = index_head_;
+        header->command = command;
+
+        int32_t written = socket_->write(frame.tx_.data(), frame.tx_size_);
+        if (written < 0)
+        {
+            THROW_SYSTEM_ERROR("write()");
+        }
+        if (written != frame.tx_size_)
+        {
+            THROW_ERROR("Wrong number of bytes written");
+        }
+
+        callbacks_[index_head_].process = process;
+        callbacks_[index_head_].error = error;
+        callbacks_[index_head_].in_error = true;
+        ++index_head_;
+
+        if (tracer_ != nullptr)
+        {
+            sent_at_[sent_frame_] = since_epoch();
+        }
+        destinations_[sent_frame_] = &frame;
+        ++sent_frame_;
+        ++sent_frames_;
+    }
+
+
+    ZeroCopyFrame& Link::createZeroCopyFrame(uint32_t address, uint16_t data_size)
+    {
+        zero_copy_frames_.push_back(std::make_unique<ZeroCopyFrame>(address, data_size));
+        return *zero_copy_frames_.back();
+    }
+
+
+    void Link::releaseZeroCopyFrames()
+    {
+        zero_copy_frames_.clear();
+    }
+
+
     void Link::finalizeDatagrams()
     {
         if (frame_.datagramCounter() != 0)
@@ -68,15 +160,26 @@ namespace kickcat
 
         uint8_t waiting_frame = sent_frame_;
         sent_frame_ = 0;
+        if (waiting_frame > 0)
+        {
+            ++round_trips_;
+        }
 
         for (int32_t i = 0; i < waiting_frame; ++i)
         {
             try
             {
-                frame_.read(socket_);
-                while (frame_.isDatagramAvailable())
+                // frames come back in sending order: read the answer in its destination buffer.
+                // If a frame was lost, the next one is read in the wrong buffer: datagrams are still dispatched by index.
+                Frame& frame = (destinations_[i] == nullptr) ? frame_ : destinations_[i]->back();
+                frame.read(socket_);
+                if (tracer_ != nullptr)
+                {
+                    tracer_->add("frame", "link", sent_at_[i], since_epoch(), Tracer::LINK);
+                }
+                while (frame.isDatagramAvailable())
                 {
-                    auto [header, data, wkc] = frame_.nextDatagram();
+                    auto [header, data, wkc] = frame.nextDatagram();
                     callbacks_[header->index].in_error = callbacks_[header->index].process(header, data, wkc);
                 }
             }
@@ -63,6 +63,24 @@ namespace kickcat
     }
 
 
+    void Mailbox::cancel(std::shared_ptr<AbstractMessage> const& message, uint32_t status)
+    {
+        message->status_ = status;
+        to_process.remove(message);
+
+        std::queue<std::shared_ptr<AbstractMessage>> waiting;
+        while (not to_send.empty())
+        {
+            if (to_send.front() != message)
+            {
+                waiting.push(to_send.front());
+            }
+            to_send.pop();
+        }
+        to_send = std::move(waiting);
+    }
+
+
     bool Mailbox::receive(uint8_t const* raw_message)
     {
         for (auto it = to_process.begin(); it != to_process.end(); ++it)
@@ -0,0 +1,369 @@
+#include <algorithm>
+
+#include "MappingPlanner.h"
+#include "Error.h"
+
+namespace kickcat
+{
+    // Ethernet wire overhead not described in the frame buffer
+    constexpr int32_t ETH_PREAMBLE_SIZE = 8;    // preamble + start of frame delimiter
+    constexpr int32_t ETH_IFG_SIZE      = 12;   // inter frame gap
+    constexpr nanoseconds ETH_BYTE_TIME{80};    // 100 Mbit/s
+
+    // helper: compute byte size from bit size, round up
+    static int32_t bits_to_bytes(int32_t bits)
+    {
+        return (bits + 7) / 8;
+    }
+
+
+    bool MappingPlanner::isBitPacked(int32_t bits) const
+    {
+        return (packing_ == BIT_PACKED) and (bits < 8);
+    }
+
+
+    bool MappingPlanner::fit(Bin const& bin, int32_t bits) const
+    {
+        if (isBitPacked(bits))
+        {
+            if ((bin.bit != 0) and ((bin.bit + bits) <= 8))
+            {
+                return true; // fit in the shared byte
+            }
+            return (bin.bytes + 1) <= MAX_ETHERCAT_PAYLOAD_SIZE;
+        }
+
+        return (bin.bytes + bits_to_bytes(bits)) <= MAX_ETHERCAT_PAYLOAD_SIZE;
+    }
+
+
+    MappingPlanner::Area MappingPlanner::place(Bin& bin, int32_t bin_index, int32_t bits) const
+    {
+        Area area{bin_index, 0, 0, false};
+
+        if (not isBitPacked(bits))
+        {
+            // byte aligned: a partially used byte is left as is
+            area.address = bin.bytes;
+            bin.bytes += bits_to_bytes(bits);
+            bin.bit = 0;
+            return area;
+        }
+
+        area.is_bit_packed = true;
+        if ((bin.bit != 0) and ((bin.bit + bits) <= 8))
+        {
+            area.address   = bin.bytes - 1;
+            area.start_bit = static_cast<uint8_t>(bin.bit);
+            bin.bit += bits;
+        }
+        else
+        {
+            area.address = bin.bytes;
+            bin.bytes += 1;
+            bin.bit = bits;
+        }
+
+        if (bin.bit == 8)
+        {
+            bin.bit = 0; // shared byte is full
+        }
+        return area;
+    }
+
+
+    std::vector<MappingPlanner::Bin> MappingPlanner::pack(std::vector<Item> const& items, bool decreasing_order, std::vector<Area>& areas) const
+    {
+        std::vector<Bin> bins;
+        std::vector<Item> free_items;
+
+        // pinned slaves first: they choose their bin
+        for (auto const& item : items)
+        {
+            if (bits_to_bytes(item.bits) > MAX_ETHERCAT_PAYLOAD_SIZE)
+            {
+                THROW_ERROR("Slave PI is too big to fit in a frame");
+            }
+
+            auto pin = pins_.find(item.slave);
+            if (pin == pins_.end())
+            {
+                free_items.push_back(item);
+                continue;
+            }
+
+            if (pin->second < 0)
+            {
+                THROW_ERROR("Invalid pinned frame");
+            }
+
+            if (bins.size() <= static_cast<size_t>(pin->second))
+            {
+                bins.resize(pin->second + 1);
+            }
+
+            if (not fit(bins[pin->second], item.bits))
+            {
+                THROW_ERROR("Pinned slaves do not fit in their frame");
+            }
+            areas[item.slave] = place(bins[pin->second], pin->second, item.bits);
+        }
+
+        if (decreasing_order)
+        {
+            std::stable_sort(free_items.begin(), free_items.end(),
+                [](Item const& lhs, Item const& rhs) { return lhs.bits > rhs.bits; });
+        }
+
+        // first fit
+        for (auto const& item : free_items)
+        {
+            size_t i = 0;
+            while ((i < bins.size()) and (not fit(bins[i], item.bits)))
+            {
+                ++i;
+            }
+
+            if (i == bins.size())
+            {
+                bins.emplace_back();
+            }
+            areas[item.slave] = place(bins[i], static_cast<int32_t>(i), item.bits);
+        }
+
+        return bins;
+    }
+
+
+    std::vector<MappingPlanner::Bin> MappingPlanner::packBest(std::vector<Item> const& items, std::vector<Area>& areas) const
+    {
+        // Slaves order is kept unless sorting them reduces the frames number
+        std::vector<Area> sorted_areas = areas;
+        auto in_order = pack(items, false, areas);
+        auto sorted   = pack(items, true,  sorted_areas);
+
+        auto used = [](std::vector<Bin> const& bins)
+        {
+            return std::count_if(bins.begin(), bins.end(), [](Bin const& bin) { return bin.bytes != 0; });
+        };
+
+        if (used(sorted) < used(in_order))
+        {
+            areas = std::move(sorted_areas);
+            return sorted;
+        }
+        return in_order;
+    }
+
+
+    MappingPlanner::Plan MappingPlanner::planOverlapped(std::vector<Entry> const& slaves) const
+    {
+        Plan plan;
+        plan.layout = OVERLAPPED;
+
+        std::vector<Item> items;
+        for (size_t i = 0; i < slaves.size(); ++i)
+        {
+            int32_t bits = std::max(slaves[i].input_size, slaves[i].output_size);
+            if (bits > 0)
+            {
+                items.push_back({static_cast<int32_t>(i), bits});
+            }
+        }
+
+        std::vector<Area> areas(slaves.size(), Area{-1, 0, 0, false});
+        auto bins = packBest(items, areas);
+
+        // drop empty bins (unused pinned frames index)
+        std::vector<int32_t> frame_index(bins.size(), -1);
+        for (size_t i = 0; i < bins.size(); ++i)
+        {
+            if (bins[i].bytes != 0)
+            {
+                frame_index[i] = static_cast<int32_t>(plan.frames.size());
+                uint32_t address = plan.frames.size() * MAX_ETHERCAT_PAYLOAD_SIZE;
+                plan.frames.push_back({address, bins[i].bytes, 0, 0});
+            }
+        }
+
+        for (size_t i = 0; i < slaves.size(); ++i)
+        {
+            Area area = areas[i];
+            if (area.frame >= 0)
+            {
+                area.frame = frame_index[area.frame];
+                area.address += plan.frames[area.frame].address;
+            }
+
+            plan.inputs.push_back (area);
+            plan.outputs.push_back(area);
+            if ((area.frame < 0) or (slaves[i].input_size == 0))
+            {
+                plan.inputs.back() = Area{-1, 0, 0, false};
+            }
+            else
+            {
+                plan.frames[area.frame].inputs++;
+            }
+
+            if ((area.frame < 0) or (slaves[i].output_size == 0))
+            {
+                plan.outputs.back() = Area{-1, 0, 0, false};
+            }
+            else
+            {
+                plan.frames[area.frame].outputs++;
+            }
+        }
+
+        evaluate(plan);
+        return plan;
+    }
+
+
+    MappingPlanner::Plan MappingPlanner::planSeparated(std::vector<Entry> const& slaves) const
+    {
+        Plan plan;
+        plan.layout = SEPARATED;
+        plan.inputs.resize (slaves.size(), Area{-1, 0, 0, false});
+        plan.outputs.resize(slaves.size(), Area{-1, 0, 0, false});
+
+        auto packArea = [&](bool is_input)
+        {
+            std::vector<Item> items;
+            for (size_t i = 0; i < slaves.size(); ++i)
+            {
+                int32_t bits = is_input ? slaves[i].input_size : slaves[i].output_size;
+                if (bits > 0)
+                {
+                    items.push_back({static_cast<int32_t>(i), bits});
+                }
+            }
+
+            auto& areas = is_input ? plan.inputs : plan.outputs;
+            auto bins = packBest(items, areas);
+
+            std::vector<int32_t> frame_index(bins.size(), -1);
+            for (size_t i = 0; i < bins.size(); ++i)
+            {
+                if (bins[i].bytes != 0)
+                {
+                    frame_index[i] = static_cast<int32_t>(plan.frames.size());
+                    uint32_t address = plan.frames.size() * MAX_ETHERCAT_PAYLOAD_SIZE;
+                    plan.frames.push_back({address, bins[i].bytes, 0, 0});
+                }
+            }
+
+            for (auto& area : areas)
+            {
+                if (area.frame >= 0)
+                {
+                    area.frame = frame_index[area.frame];
+                    area.address += plan.frames[area.frame].address;
+                    if (is_input)
+                    {
+                        plan.frames[area.frame].inputs++;
+                    }
+                    else
+                    {
+                        plan.frames[area.frame].outputs++;
+                    }
+                }
+            }
+        };
+
+        packArea(true);     // inputs area first
+        packArea(false);
+
+        evaluate(plan);
+        return plan;
+    }
+
+
+    void MappingPlanner::evaluate(Plan& plan) const
+    {
+        // logical datagrams of one cycle, in sending order
+        std::vector<int32_t> datagrams;
+        if (exchange_ == READ_WRITE)
+        {
+            for (auto const& frame : plan.frames)
+            {
+                datagrams.push_back(frame.size);
+            }
+        }
+        else
+        {
+            for (auto const& frame : plan.frames)
+            {
+                if (frame.inputs > 0)
+                {
+                    datagrams.push_back(frame.size);
+                }
+            }
+            for (auto const& frame : plan.frames)
+            {
+                if (frame.outputs > 0)
+                {
+                    datagrams.push_back(frame.size);
+                }
+            }
+        }
+
+        // datagrams are packed in Ethernet frames in order (as the link does)
+        constexpr int32_t FRAME_CAPACITY = ETH_MTU_SIZE - sizeof(EthercatHeader);
+        auto wireSize = [](int32_t used)
+        {
+            int32_t size = sizeof(EthernetHeader) + sizeof(EthercatHeader) + used;
+            size = std::max(size, ETH_MIN_SIZE);
+            return size + ETH_FCS_SIZE + ETH_PREAMBLE_SIZE + ETH_IFG_SIZE;
+        };
+
+        plan.datagrams = static_cast<int32_t>(datagrams.size());
+        plan.ethernet_frames = 0;
+        plan.wire_bytes = 0;
+
+        int32_t used = 0;
+        int32_t counter = 0;
+        for (int32_t size : datagrams)
+        {
+            int32_t needed = datagram_size(static_cast<uint16_t>(size));
+            if ((counter != 0) and (((used + needed) > FRAME_CAPACITY) or (counter == MAX_ETHERCAT_DATAGRAMS)))
+            {
+                plan.wire_bytes += wireSize(used);
+                plan.ethernet_frames++;
+                used = 0;
+                counter = 0;
+            }
+            used += needed;
+            counter++;
+        }
+        if (counter != 0)
+        {
+            plan.wire_bytes += wireSize(used);
+            plan.ethernet_frames++;
+        }
+
+        plan.wire_time = plan.wire_bytes * ETH_BYTE_TIME;
+    }
+
+
+    MappingPlanner::Plan MappingPlanner::plan(std::vector<Entry> const& slaves) const
+    {
+        switch (layout_)
+        {
+            case OVERLAPPED: { return planOverlapped(slaves); }
+            case SEPARATED:  { return planSeparated(slaves);  }
+            default:
+            {
+                Plan overlapped = planOverlapped(slaves);
+                Plan separated  = planSeparated(slaves);
+                if (separated.wire_time < overlapped.wire_time)
+                {
+                    return separated;
+                }
+                return overlapped;
+            }
+        }
+    }
+}
@@ -0,0 +1,91 @@
+#include <cstdio>
+
+#include "SIICache.h"
+#include "Error.h"
+
+namespace kickcat
+{
+    constexpr uint32_t SII_CACHE_MAGIC = 0x49495343; // 'CSII'
+
+    struct SIICacheHeader
+    {
+        uint32_t magic;
+        uint32_t size;      // in 32 bits words
+    };
+
+
+    SIICache::SIICache(std::string const& directory)
+        : directory_(directory)
+    {
+        if ((not directory_.empty()) and (directory_.back() != '/'))
+        {
+            directory_ += '/';
+        }
+    }
+
+
+    std::string SIICache::path(Slave const& slave) const
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "%08x_%08x_%08x_%08x_%04x.sii",
+                 slave.vendor_id, slave.product_code, slave.revision_number, slave.serial_number, slave.eeprom_crc);
+        return directory_ + name;
+    }
+
+
+    bool SIICache::load(Slave& slave) const
+    {
+        FILE* file = fopen(path(slave).c_str(), "rb");
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        std::vector<uint32_t> buffer;
+        SIICacheHeader header;
+        bool is_valid = (fread(&header, sizeof(header), 1, file) == 1) and (header.magic == SII_CACHE_MAGIC)
+                    and (header.size > 0) and (header.size <= (slave.eeprom_size / sizeof(uint32_t)));  // never above the EEPROM
+        if (is_valid)
+        {
+            buffer.resize(header.size);
+            is_valid = (fread(buffer.data(), sizeof(uint32_t), buffer.size(), file) == buffer.size())
+                   and (not buffer.empty())
+                   and ((buffer.back() >> 16) == eeprom::Category::End);
+        }
+        fclose(file);
+
+        if (not is_valid)
+        {
+            DEBUG_PRINT("Invalid SII cache entry %s\n", path(slave).c_str());
+            return false;
+        }
+
+        slave.sii.buffer = std::move(buffer);
+        return true;
+    }
+
+
+    void SIICache::store(Slave const& slave) const
+    {
+        // write then rename: a concurrent or interrupted store never leaves a partial entry
+        std::string entry = path(slave);
+        std::string tmp = entry + ".tmp";
+        FILE* file = fopen(tmp.c_str(), "wb");
+        if (file == nullptr)
+        {
+            DEBUG_PRINT("Cannot create SII cache entry %s\n", entry.c_str());
+            return;
+        }
+
+        SIICacheHeader header{SII_CACHE_MAGIC, static_cast<uint32_t>(slave.sii.buffer.size())};
+        bool is_written = (fwrite(&header, sizeof(header), 1, file) == 1)
+                      and (fwrite(slave.sii.buffer.data(), sizeof(uint32_t), slave.sii.buffer.size(), file) == slave.sii.buffer.size());
+        is_written = (fclose(file) == 0) and is_written;
+
+        if ((not is_written) or (rename(tmp.c_str(), entry.c_str()) != 0))
+        {
+            DEBUG_PRINT("Cannot write SII cache entry %s\n", entry.c_str());
+            remove(tmp.c_str());
+        }
+    }
+}
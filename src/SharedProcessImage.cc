@@ -0,0 +1,93 @@
+#include <cstring>
+
+#include "SharedProcessImage.h"
+
+namespace kickcat
+{
+    TripleBuffer::TripleBuffer(int32_t size)
+        : size_{size}
+        , stride_{(size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT}
+        , data_(stride_ * 3, 0)
+    {
+
+    }
+
+
+    void TripleBuffer::publish()
+    {
+        // give the written buffer and take back the previous middle one
+        uint8_t previous = middle_.exchange(write_ | FRESH, std::memory_order_acq_rel);
+        write_ = previous & INDEX_MASK;
+    }
+
+
+    bool TripleBuffer::acquire()
+    {
+        if ((middle_.load(std::memory_order_relaxed) & FRESH) == 0)
+        {
+            return false;
+        }
+
+        // only the consumer clears the fresh flag: it is still set here
+        uint8_t previous = middle_.exchange(read_, std::memory_order_acq_rel);
+        read_ = previous & INDEX_MASK;
+        return true;
+    }
+
+
+    SharedProcessImage::SharedProcessImage(uint8_t* iomap, int32_t inputs_size, int32_t outputs_size)
+        : iomap_{iomap}
+        , inputs_(inputs_size)
+        , outputs_(outputs_size)
+    {
+        // start from the current content of the client buffer
+        std::memcpy(outputs_.writeBuffer(), iomap_ + inputs_size, outputs_size);
+    }
+
+
+    void SharedProcessImage::publishInputs()
+    {
+        std::memcpy(inputs_.writeBuffer(), iomap_, inputs_.size());
+        inputs_.publish();
+    }
+
+
+    bool SharedProcessImage::acquireOutputs()
+    {
+        if (not outputs_.acquire())
+        {
+            return false; // keep sending the last outputs
+        }
+
+        std::memcpy(iomap_ + inputs_.size(), outputs_.readBuffer(), outputs_.size());
+        return true;
+    }
+
+
+    bool SharedProcessImage::acquireInputs()
+    {
+        return inputs_.acquire();
+    }
+
+
+    uint8_t const* SharedProcessImage::inputs(Slave const& slave) const
+    {
+        return inputs_.readBuffer() + (slave.input.data - iomap_);
+    }
+
+
+    uint8_t* SharedProcessImage::outputs(Slave const& slave)
+    {
+        return outputs_.writeBuffer() + (slave.output.data - iomap_ - inputs_.size());
+    }
+
+
+    void SharedProcessImage::commitOutputs()
+    {
+        uint8_t const* committed = outputs_.writeBuffer();
+        outputs_.publish();
+
+        // next outputs set starts from the committed one (the cyclic thread only reads it)
+        std::memcpy(outputs_.writeBuffer(), committed, outputs_.size());
+    }
+}
@@ -32,6 +32,7 @@ namespace kickcat
             }
 
             // only possible if timespec is wrongly defined or wrong clock ID
+            errno = result; // clock_nanosleep() returns the error instead of setting errno
             THROW_SYSTEM_ERROR("clock_nanosleep()");
         }
     }
@@ -48,4 +49,37 @@ namespace kickcat
     {
         return since_epoch() - start;
     }
-}
\ No newline at end of file
+
+
+    nanoseconds monotonic_time()
+    {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return seconds(now.tv_sec) + nanoseconds(now.tv_nsec);
+    }
+
+
+    void sleep_until(nanoseconds deadline)
+    {
+        auto secs = duration_cast<seconds>(deadline);
+        timespec wakeup{secs.count(), (deadline - secs).count()};
+
+        while (true)
+        {
+            int32_t result = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeup, nullptr);
+            if (result == 0)
+            {
+                return;
+            }
+
+            if (result == EINTR)
+            {
+                // call interrupted by a POSIX signal: deadline is absolute, sleep again.
+                continue;
+            }
+
+            errno = result; // clock_nanosleep() returns the error instead of setting errno
+            THROW_SYSTEM_ERROR("clock_nanosleep()");
+        }
+    }
+}
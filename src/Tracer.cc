@@ -0,0 +1,84 @@
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <set>
+
+#include "Tracer.h"
+#include "Error.h"
+
+namespace kickcat
+{
+    void Tracer::save(std::string const& path) const
+    {
+        FILE* file = fopen(path.c_str(), "w");
+        if (file == nullptr)
+        {
+            THROW_SYSTEM_ERROR("fopen()");
+        }
+
+        // JSON string: names are built by the bus, only quotes and backslashes need an escape
+        auto escape = [](std::string const& text)
+        {
+            std::string escaped;
+            for (char c : text)
+            {
+                if ((c == '"') or (c == '\\'))
+                {
+                    escaped += '\\';
+                }
+                escaped += c;
+            }
+            return escaped;
+        };
+
+        fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+        fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"kickcat\"}}", BUS);
+        std::set<int32_t> lanes{BUS, LINK};
+        for (auto const& event : events_)
+        {
+            lanes.insert(event.lane);
+        }
+        for (int32_t lane : lanes)
+        {
+            char name[32];
+            switch (lane)
+            {
+                case BUS:  { snprintf(name, sizeof(name), "bus");  break; }
+                case LINK: { snprintf(name, sizeof(name), "link"); break; }
+                default:   { snprintf(name, sizeof(name), "slave %" PRId32, lane - SLAVE); }
+            }
+            fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%" PRId32 ",\"args\":{\"name\":\"%s\"}}", lane, name);
+        }
+
+        // timestamps in microseconds, relative to the first event: printed from the integer nanoseconds so the
+        // nanosecond part is exact (epoch based values do not fit a double at this resolution)
+        nanoseconds origin{0};
+        if (not events_.empty())
+        {
+            origin = events_.front().start;
+            for (auto const& event : events_)
+            {
+                origin = std::min(origin, event.start);
+            }
+        }
+        auto us = [](nanoseconds time)
+        {
+            char text[32];
+            int64_t ns = static_cast<int64_t>(time.count());
+            snprintf(text, sizeof(text), "%" PRId64 ".%03" PRId64, ns / 1000, ns % 1000);
+            return std::string(text);
+        };
+        for (auto const& event : events_)
+        {
+            fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%" PRId32 ",\"ts\":%s,\"dur\":%s}",
+                    escape(event.name).c_str(), event.category, event.lane,
+                    us(event.start - origin).c_str(), us(event.duration).c_str());
+        }
+        fprintf(file, "\n]}\n");
+
+        if (fclose(file) != 0)
+        {
+            THROW_SYSTEM_ERROR("fclose()");
+        }
+    }
+}
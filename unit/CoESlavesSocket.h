@@ -0,0 +1,201 @@
+#ifndef KICKCAT_UNIT_COE_SLAVES_SOCKET_H
+#define KICKCAT_UNIT_COE_SLAVES_SOCKET_H
+
+#include <array>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include "kickcat/AbstractSocket.h"
+#include "kickcat/Frame.h"
+#include "kickcat/Slave.h"
+
+namespace kickcat
+{
+    // Emulate CoE slaves mailboxes: an SDO request written in a slave mailbox is answered on the next mailbox check.
+    // The object dictionary holds the PDO mapping of a typical drive:
+    // - outputs: control word (16 bits) and mode of operation (8 bits)
+    // - inputs:  status word (16 bits), position (32 bits) and mode display (8 bits)
+    // Others datagrams (i.e. SM/FMMU configuration) get a working counter of 1.
+    class CoESlavesSocket : public AbstractSocket
+    {
+    public:
+        static constexpr uint16_t MAILBOX_OUT  = 0x1000;
+        static constexpr uint16_t MAILBOX_IN   = 0x1080;
+        static constexpr uint16_t MAILBOX_SIZE = 128;
+
+        void open(std::string const&, microseconds) override {}
+        void close() noexcept override {}
+
+        // Add a slave to the bus and emulate it
+        void addSlave(std::vector<Slave>& slaves, uint16_t address)
+        {
+            Slave slave{};
+            slave.address = address;
+            slave.supported_mailbox = eeprom::MailboxProtocol::CoE;
+            slave.mailbox.recv_offset = MAILBOX_OUT;
+            slave.mailbox.recv_size   = MAILBOX_SIZE;
+            slave.mailbox.send_offset = MAILBOX_IN;
+            slave.mailbox.send_size   = MAILBOX_SIZE;
+            slave.sii.syncManagers_ = {&mailbox_sm_, &mailbox_sm_, &outputs_sm_, &inputs_sm_};
+            slaves.push_back(slave);
+
+            emulated_[address] = {};
+        }
+
+        int32_t write(uint8_t const* frame, int32_t frame_size) override
+        {
+            auto& answer = frames_[head_ % frames_.size()];
+            std::memcpy(answer.data(), frame, frame_size);
+            sizes_[head_ % frames_.size()] = frame_size;
+            ++head_;
+
+            bool is_mailbox_check = false;
+            uint8_t* pos = answer.data() + sizeof(EthernetHeader) + sizeof(EthercatHeader);
+            DatagramHeader* header;
+            do
+            {
+                header = reinterpret_cast<DatagramHeader*>(pos);
+                uint8_t* data = pos + sizeof(DatagramHeader);
+                uint16_t* wkc = reinterpret_cast<uint16_t*>(data + header->len);
+                *wkc = process(header, data, is_mailbox_check);
+                pos += datagram_size(header->len);
+            } while (header->multiple);
+
+            if (is_mailbox_check)
+            {
+                ++mailbox_check_frames;
+            }
+            return frame_size;
+        }
+
+        int32_t read(uint8_t* frame, int32_t) override
+        {
+            auto& answer = frames_[tail_ % frames_.size()];
+            int32_t size = sizes_[tail_ % frames_.size()];
+            ++tail_;
+            std::memcpy(frame, answer.data(), size);
+            return size;
+        }
+
+        int32_t mailbox_check_frames{0};  // frames checking the mailboxes states
+
+    private:
+        struct Answer
+        {
+            mailbox::Header header;
+            mailbox::ServiceData sdo;
+            uint8_t payload[4];
+        } __attribute__((__packed__));
+
+        struct EmulatedSlave
+        {
+            bool has_answer{false};
+            Answer answer;
+        };
+
+        struct Object
+        {
+            uint32_t entry_size;            // in bytes
+            std::vector<uint32_t> entries;  // subindex 1 to N
+        };
+
+        uint16_t process(DatagramHeader const* header, uint8_t* data, bool& is_mailbox_check)
+        {
+            uint16_t address = header->address & 0xFFFF;
+            uint16_t offset  = static_cast<uint16_t>(header->address >> 16);
+            auto it = emulated_.find(address);
+            if ((header->command == Command::NOP) or (it == emulated_.end()))
+            {
+                return 1;
+            }
+            auto& slave = it->second;
+
+            if (header->command == Command::FPRD)
+            {
+                switch (offset)
+                {
+                    case reg::SYNC_MANAGER_0 + reg::SM_STATS:
+                    {
+                        is_mailbox_check = true;
+                        data[0] = 0;                            // request already processed: mailbox is empty
+                        break;
+                    }
+                    case reg::SYNC_MANAGER_1 + reg::SM_STATS:
+                    {
+                        data[0] = slave.has_answer ? 0x08 : 0;
+                        break;
+                    }
+                    case MAILBOX_IN:
+                    {
+                        std::memcpy(data, &slave.answer, sizeof(Answer));
+                        slave.has_answer = false;
+                        break;
+                    }
+                    default: { }
+                }
+                return 1;
+            }
+
+            if ((header->command == Command::FPWR) and (offset == MAILBOX_OUT))
+            {
+                auto request = reinterpret_cast<mailbox::ServiceData const*>(data + sizeof(mailbox::Header));
+                answer(slave, request);
+            }
+            return 1;
+        }
+
+        void answer(EmulatedSlave& slave, mailbox::ServiceData const* request)
+        {
+            Answer& answer = slave.answer;
+            std::memset(&answer, 0, sizeof(Answer));
+            answer.header.len  = 10;
+            answer.header.type = mailbox::Type::CoE;
+            answer.sdo.service  = CoE::Service::SDO_RESPONSE;
+            answer.sdo.index    = request->index;
+            answer.sdo.subindex = request->subindex;
+            slave.has_answer = true;
+
+            if (request->command == CoE::SDO::request::DOWNLOAD)
+            {
+                answer.sdo.command = CoE::SDO::response::DOWNLOAD;
+                return;
+            }
+
+            Object const& object = dictionary_.at(request->index);
+            uint32_t value = static_cast<uint32_t>(object.entries.size());
+            uint32_t size  = 1;
+            if (request->subindex != 0)
+            {
+                value = object.entries.at(request->subindex - 1);
+                size  = object.entry_size;
+            }
+
+            answer.sdo.command       = CoE::SDO::response::UPLOAD;
+            answer.sdo.transfer_type = 1;
+            answer.sdo.block_size    = (4 - size) & 0x3;
+            std::memcpy(answer.payload, &value, sizeof(value));
+        }
+
+        std::map<uint16_t, Object> const dictionary_
+        {
+            { CoE::SM_COM_TYPE,      {1, {1, 2, 3, 4}} },
+            { CoE::SM_CHANNEL + 2,   {2, {CoE::RxPDO_MAPPING}} },
+            { CoE::SM_CHANNEL + 3,   {2, {CoE::TxPDO_MAPPING}} },
+            { CoE::RxPDO_MAPPING,    {4, {0x60400010, 0x60600008}} },
+            { CoE::TxPDO_MAPPING,    {4, {0x60410010, 0x60640020, 0x60610008}} },
+        };
+
+        eeprom::SyncManagerEntry mailbox_sm_{MAILBOX_OUT, MAILBOX_SIZE, 0x26, 0, 1, 1};
+        eeprom::SyncManagerEntry outputs_sm_{0x1100, 3, 0x64, 0, 1, 3};
+        eeprom::SyncManagerEntry inputs_sm_ {0x1200, 7, 0x20, 0, 1, 4};
+
+        std::map<uint16_t, EmulatedSlave> emulated_;
+        std::array<EthernetFrame, 32> frames_;
+        std::array<int32_t, 32> sizes_;
+        uint32_t head_{0};
+        uint32_t tail_{0};
+    };
+}
+
+#endif
@@ -0,0 +1,447 @@
+#ifndef KICKCAT_UNIT_ESC_SLAVES_SOCKET_H
+#define KICKCAT_UNIT_ESC_SLAVES_SOCKET_H
+
+#include <array>
+#include <cstring>
+#include <vector>
+
+#include "kickcat/AbstractSocket.h"
+#include "kickcat/Frame.h"
+#include "kickcat/Slave.h"
+#include "kickcat/Time.h"
+
+namespace kickcat
+{
+    // Emulate the ESC registers of a chain of slaves: position, configured and broadcast addressing with the working
+    // counter of each command. Registers are plain memory (0x0000 to 0x0FFF) with the side effects used by the init:
+    // - AL control: the requested state is reached after the slave AL latency (AL status), or refused with an error
+    // - EEPROM control: a read request is busy for the configured latency, then the data register holds the SII words
+    // - standard mailbox: an SDO request is answered at once (download acknowledged or aborted, upload of a null value),
+    //   or never
+    // - logical read: registers mapped by the read FMMUs, bit by bit
+    // Logical writes and the rest of the process memory are not emulated.
+    class ESCSlavesSocket : public AbstractSocket
+    {
+    public:
+        static constexpr uint16_t MAILBOX_OUT  = 0x1000;
+        static constexpr uint16_t MAILBOX_IN   = 0x1080;
+        static constexpr uint16_t MAILBOX_SIZE = 128;
+
+        void open(std::string const&, microseconds) override {}
+        void close() noexcept override {}
+
+        // Build a CoE slave SII with a strings category of 'strings_size' words (to vary the SII size)
+        static std::vector<uint16_t> createSII(uint32_t vendor_id, uint32_t product_code, uint16_t strings_size)
+        {
+            std::vector<uint16_t> sii(eeprom::START_CATEGORY, 0);
+            auto set32 = [&sii](uint16_t address, uint32_t value)
+            {
+                sii[address]     = static_cast<uint16_t>(value);
+                sii[address + 1] = static_cast<uint16_t>(value >> 16);
+            };
+            set32(eeprom::VENDOR_ID,       vendor_id);
+            set32(eeprom::PRODUCT_CODE,    product_code);
+            set32(eeprom::REVISION_NUMBER, 1);
+            set32(eeprom::SERIAL_NUMBER,   0x1000 + strings_size);
+            set32(eeprom::STANDARD_MAILBOX + eeprom::RECV_MBO_OFFSET, MAILBOX_OUT | (MAILBOX_SIZE << 16));
+            set32(eeprom::STANDARD_MAILBOX + eeprom::SEND_MBO_OFFSET, MAILBOX_IN  | (MAILBOX_SIZE << 16));
+            sii[eeprom::MAILBOX_PROTOCOL] = eeprom::MailboxProtocol::CoE;
+            sii[eeprom::EEPROM_SIZE]      = 0x000F;     // 2 KiB
+            sii[eeprom::EEPROM_VERSION]   = 1;
+
+            sii.push_back(eeprom::Category::Strings);
+            sii.push_back(strings_size);
+            sii.insert(sii.end(), strings_size, 0);     // no string
+
+            eeprom::SyncManagerEntry sm[] =
+            {
+                {MAILBOX_OUT, MAILBOX_SIZE, 0x26, 0, 1, 1},
+                {MAILBOX_IN,  MAILBOX_SIZE, 0x22, 0, 1, 2},
+                {0x1100,      3,            0x64, 0, 1, 3},
+                {0x1200,      7,            0x20, 0, 1, 4},
+            };
+            sii.push_back(eeprom::Category::SyncM);
+            uint16_t sm_size = sizeof(sm) / 2;     // in words
+            sii.push_back(sm_size);
+            std::size_t pos = sii.size();
+            sii.resize(pos + sm_size);
+            std::memcpy(sii.data() + pos, sm, sizeof(sm));
+
+            sii.push_back(eeprom::Category::End);
+            sii.push_back(eeprom::Category::End);
+            return sii;
+        }
+
+        // Add a slave at the end of the chain. 'read_8_bytes': the ESC reads 8 bytes per EEPROM request (4 otherwise)
+        void addSlave(std::vector<uint16_t> sii, bool read_8_bytes = true)
+        {
+            EmulatedSlave slave{};
+            slave.sii = std::move(sii);
+            slave.read_8_bytes = read_8_bytes;
+            if (read_8_bytes)
+            {
+                reg<uint16_t>(slave, reg::EEPROM_CONTROL) = EEPROM_8BYTES;
+            }
+            reg<uint8_t>(slave, reg::FMMU_SUP) = 8;
+            slaves_.push_back(std::move(slave));
+        }
+
+        // FMMUs supported by the ESC of the slave at 'position' (8 by default)
+        void setFMMUs(int32_t position, uint8_t count) { reg<uint8_t>(slaves_.at(position), reg::FMMU_SUP) = count; }
+
+        // Time spent by an EEPROM read request (busy), for 4 bytes
+        void setEepromLatency(nanoseconds latency) { eeprom_latency_ = latency; }
+
+        // Time to reach a requested state, and AL status code of the next requests (0: no error)
+        void setALLatency(int32_t position, nanoseconds latency) { slaves_.at(position).al_latency = latency; }
+        void setALError(int32_t position, uint16_t code)         { slaves_.at(position).al_error = code; }
+
+        struct SDOWrite
+        {
+            uint16_t index;
+            uint8_t  subindex;
+            uint32_t value;
+        };
+        // SDO downloads received by the slave at 'position'
+        std::vector<SDOWrite> const& sdoWrites(int32_t position) const { return slaves_.at(position).sdo_writes; }
+
+        // SDO downloads of an object refused by the slave at 'position' with an abort code
+        void setSDOAbort(int32_t position, uint16_t index, uint32_t code) { slaves_.at(position).sdo_aborts.push_back({index, 0, code}); }
+
+        // Mailbox requests received by the slave at 'position' are never answered
+        void setMailboxMute(int32_t position) { slaves_.at(position).is_mailbox_mute = true; }
+
+        int32_t write(uint8_t const* frame, int32_t frame_size) override
+        {
+            auto& answer = frames_[head_ % frames_.size()];
+            std::memcpy(answer.data(), frame, frame_size);
+            sizes_[head_ % frames_.size()] = frame_size;
+            ++head_;
+            ++frames;
+
+            uint8_t* pos = answer.data() + sizeof(EthernetHeader) + sizeof(EthercatHeader);
+            DatagramHeader* header;
+            do
+            {
+                header = reinterpret_cast<DatagramHeader*>(pos);
+                uint8_t* data = pos + sizeof(DatagramHeader);
+                uint16_t* wkc = reinterpret_cast<uint16_t*>(data + header->len);
+                *wkc = process(header, data);
+                pos += datagram_size(header->len);
+                ++datagrams;
+            } while (header->multiple);
+
+            return frame_size;
+        }
+
+        int32_t read(uint8_t* frame, int32_t) override
+        {
+            auto& answer = frames_[tail_ % frames_.size()];
+            int32_t size = sizes_[tail_ % frames_.size()];
+            ++tail_;
+            std::memcpy(frame, answer.data(), size);
+            return size;
+        }
+
+        int32_t frames{0};      // frames sent (round trips)
+        int32_t datagrams{0};   // datagrams sent
+
+    private:
+        struct MailboxAnswer
+        {
+            mailbox::Header header;
+            mailbox::ServiceData sdo;
+            uint8_t payload[4];
+        } __attribute__((__packed__));
+
+        struct EmulatedSlave
+        {
+            std::array<uint8_t, 0x1000> registers;
+            std::vector<uint16_t> sii;
+            bool read_8_bytes;
+            nanoseconds eeprom_ready{0};    // end of the pending EEPROM read, 0 if none
+            nanoseconds al_latency{0};
+            nanoseconds al_ready{0};        // end of the pending state transition, 0 if none
+            uint16_t al_error{0};
+            MailboxAnswer answer;
+            std::vector<SDOWrite> sdo_writes;
+            std::vector<SDOWrite> sdo_aborts;   // refused objects: abort code as value
+            bool is_mailbox_mute{false};
+        };
+
+        static constexpr uint16_t EEPROM_BUSY   = 0x8000;
+        static constexpr uint16_t EEPROM_8BYTES = 0x0040;
+
+        template<typename T>
+        static T& reg(EmulatedSlave& slave, uint16_t offset)
+        {
+            return *reinterpret_cast<T*>(slave.registers.data() + offset);
+        }
+
+        uint16_t process(DatagramHeader const* header, uint8_t* data)
+        {
+            uint16_t position = header->address & 0xFFFF;
+            uint16_t offset   = static_cast<uint16_t>(header->address >> 16);
+            bool is_read  = false;
+            bool is_write = false;
+
+            std::vector<EmulatedSlave*> targets;
+            switch (header->command)
+            {
+                case Command::APRD: { is_read = true;                   break; }
+                case Command::APWR: { is_write = true;                  break; }
+                case Command::APRW: { is_read = true; is_write = true;  break; }
+                case Command::FPRD: { is_read = true;                   break; }
+                case Command::FPWR: { is_write = true;                  break; }
+                case Command::FPRW: { is_read = true; is_write = true;  break; }
+                case Command::BRD:  { is_read = true;                   break; }
+                case Command::BWR:  { is_write = true;                  break; }
+                case Command::BRW:  { is_read = true; is_write = true;  break; }
+                case Command::LRD:  { return logicalRead(header->address, data, header->len); }
+                default:            { return 0; }
+            }
+
+            for (uint16_t i = 0; i < slaves_.size(); ++i)
+            {
+                auto& slave = slaves_[i];
+                switch (header->command)
+                {
+                    case Command::APRD:
+                    case Command::APWR:
+                    case Command::APRW:
+                    {
+                        if (static_cast<uint16_t>(position + i) == 0)   // auto increment
+                        {
+                            targets.push_back(&slave);
+                        }
+                        break;
+                    }
+                    case Command::FPRD:
+                    case Command::FPWR:
+                    case Command::FPRW:
+                    {
+                        if (reg<uint16_t>(slave, reg::STATION_ADDR) == position)
+                        {
+                            targets.push_back(&slave);
+                        }
+                        break;
+                    }
+                    default:
+                    {
+                        targets.push_back(&slave);
+                    }
+                }
+            }
+
+            if ((offset + header->len) > 0x1000)
+            {
+                for (auto slave : targets)
+                {
+                    processMailbox(*slave, offset, data, is_write);
+                }
+                return static_cast<uint16_t>(targets.size()); // others process memory: not emulated
+            }
+
+            std::vector<uint8_t> written(data, data + header->len);
+            if (is_read)
+            {
+                std::memset(data, 0, header->len);
+            }
+
+            uint16_t wkc = 0;
+            for (auto slave : targets)
+            {
+                if (is_read)
+                {
+                    refresh(*slave);
+                    for (uint16_t i = 0; i < header->len; ++i)
+                    {
+                        data[i] |= slave->registers[offset + i];    // broadcast read: bitwise OR
+                    }
+                    wkc += 1;
+                }
+                if (is_write)
+                {
+                    std::memcpy(slave->registers.data() + offset, written.data(), header->len);
+                    onWrite(*slave, offset, header->len);
+                    wkc += is_read ? 2 : 1;
+                }
+            }
+            return wkc;
+        }
+
+        uint16_t logicalRead(uint32_t address, uint8_t* data, uint16_t size)
+        {
+            std::memset(data, 0, size);
+            uint64_t const first = uint64_t{address} * 8;
+            uint64_t const last  = first + size * 8;
+
+            uint16_t wkc = 0;
+            for (auto& slave : slaves_)
+            {
+                bool is_mapped = false;
+                for (int32_t i = 0; i < 16; ++i)
+                {
+                    FMMU const& fmmu = reg<FMMU>(slave, static_cast<uint16_t>(reg::FMMU + i * 16));
+                    if ((not fmmu.activate) or (not (fmmu.type & 1)) or (fmmu.length == 0))
+                    {
+                        continue;
+                    }
+
+                    uint64_t logical  = uint64_t{fmmu.logical_address} * 8 + fmmu.logical_start_bit;
+                    uint32_t physical = fmmu.physical_address * 8u + fmmu.physical_start_bit;
+                    int32_t bits = (fmmu.length - 1) * 8 + fmmu.logical_stop_bit + 1 - fmmu.logical_start_bit;
+                    for (int32_t bit = 0; bit < bits; ++bit)
+                    {
+                        uint64_t target = logical + bit;
+                        if ((target < first) or (target >= last))
+                        {
+                            continue;
+                        }
+                        is_mapped = true;
+                        uint32_t source = physical + bit;
+                        if ((slave.registers[source / 8] >> (source % 8)) & 1)
+                        {
+                            data[(target - first) / 8] |= static_cast<uint8_t>(1 << ((target - first) % 8));
+                        }
+                    }
+                }
+                if (is_mapped)
+                {
+                    ++wkc;
+                }
+            }
+            return wkc;
+        }
+
+        void processMailbox(EmulatedSlave& slave, uint16_t offset, uint8_t* data, bool is_write)
+        {
+            uint8_t& sm1_status = slave.registers[reg::SYNC_MANAGER_1 + reg::SM_STATS];
+            if ((offset == MAILBOX_IN) and (not is_write))
+            {
+                std::memcpy(data, &slave.answer, sizeof(MailboxAnswer));
+                sm1_status = 0;
+                return;
+            }
+            if ((offset != MAILBOX_OUT) or (not is_write) or slave.is_mailbox_mute)
+            {
+                return;
+            }
+
+            auto request = reinterpret_cast<mailbox::ServiceData const*>(data + sizeof(mailbox::Header));
+            MailboxAnswer& answer = slave.answer;
+            std::memset(&answer, 0, sizeof(MailboxAnswer));
+            answer.header.len   = 10;
+            answer.header.type  = mailbox::Type::CoE;
+            answer.sdo.service  = CoE::Service::SDO_RESPONSE;
+            answer.sdo.index    = request->index;
+            answer.sdo.subindex = request->subindex;
+            if (request->command == CoE::SDO::request::DOWNLOAD)
+            {
+                uint32_t value;
+                std::memcpy(&value, data + sizeof(mailbox::Header) + sizeof(mailbox::ServiceData), sizeof(value));
+                answer.sdo.command = CoE::SDO::response::DOWNLOAD;
+                for (auto const& abort : slave.sdo_aborts)
+                {
+                    if (abort.index == request->index)
+                    {
+                        answer.sdo.command = CoE::SDO::request::ABORT;
+                        std::memcpy(answer.payload, &abort.value, sizeof(abort.value));
+                    }
+                }
+                if (answer.sdo.command == CoE::SDO::response::DOWNLOAD)
+                {
+                    slave.sdo_writes.push_back({request->index, request->subindex, value});
+                }
+            }
+            else
+            {
+                answer.sdo.command       = CoE::SDO::response::UPLOAD;
+                answer.sdo.transfer_type = 1;
+            }
+            sm1_status = 0x08;  // mailbox full
+        }
+
+        static bool covers(uint16_t offset, uint16_t size, uint16_t address)
+        {
+            return (offset <= address) and (address < (offset + size));
+        }
+
+        void onWrite(EmulatedSlave& slave, uint16_t offset, uint16_t size)
+        {
+            if (covers(offset, size, reg::AL_CONTROL))
+            {
+                slave.al_ready = monotonic_time() + slave.al_latency;
+                refreshState(slave);
+            }
+
+            if (covers(offset, size, reg::EEPROM_CONTROL))
+            {
+                uint16_t& control = reg<uint16_t>(slave, reg::EEPROM_CONTROL);
+                if (control == eeprom::Command::READ)
+                {
+                    nanoseconds latency = slave.read_8_bytes ? eeprom_latency_ * 2 : eeprom_latency_;
+                    slave.eeprom_ready = monotonic_time() + latency;
+                    control = EEPROM_BUSY;
+                }
+                if (slave.read_8_bytes)
+                {
+                    control |= EEPROM_8BYTES;
+                }
+            }
+        }
+
+        void refreshState(EmulatedSlave& slave)
+        {
+            if ((slave.al_ready == 0ns) or (monotonic_time() < slave.al_ready))
+            {
+                return;
+            }
+            slave.al_ready = 0ns;
+
+            uint16_t request = reg<uint16_t>(slave, reg::AL_CONTROL) & 0x0F;
+            if (slave.al_error != 0)
+            {
+                reg<uint16_t>(slave, reg::AL_STATUS) |= 0x10;   // error: the state is kept
+                reg<uint16_t>(slave, reg::AL_STATUS_CODE) = slave.al_error;
+                return;
+            }
+            reg<uint16_t>(slave, reg::AL_STATUS)      = request;
+            reg<uint16_t>(slave, reg::AL_STATUS_CODE) = 0;
+        }
+
+        void refresh(EmulatedSlave& slave)
+        {
+            refreshState(slave);
+            refreshEeprom(slave);
+        }
+
+        void refreshEeprom(EmulatedSlave& slave)
+        {
+            if ((slave.eeprom_ready == 0ns) or (monotonic_time() < slave.eeprom_ready))
+            {
+                return;
+            }
+            slave.eeprom_ready = 0ns;
+
+            uint32_t address = reg<uint32_t>(slave, reg::EEPROM_ADDRESS);
+            uint16_t* data = &reg<uint16_t>(slave, reg::EEPROM_DATA);
+            int32_t words = slave.read_8_bytes ? 4 : 2;
+            for (int32_t i = 0; i < words; ++i)
+            {
+                uint32_t word = address + i;
+                data[i] = (word < slave.sii.size()) ? slave.sii[word] : 0xFFFF;   // erased EEPROM
+            }
+            reg<uint16_t>(slave, reg::EEPROM_CONTROL) &= static_cast<uint16_t>(~EEPROM_BUSY);
+        }
+
+        std::vector<EmulatedSlave> slaves_;
+        nanoseconds eeprom_latency_{0};
+        std::array<EthernetFrame, 32> frames_;
+        std::array<int32_t, 32> sizes_;
+        uint32_t head_{0};
+        uint32_t tail_{0};
+    };
+}
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef KICKCAT_UNIT_LOOPBACK_SOCKET_H
+#define KICKCAT_UNIT_LOOPBACK_SOCKET_H
+
+#include <array>
+#include <cstring>
+#include <vector>
+
+#include "kickcat/AbstractSocket.h"
+#include "kickcat/Bus.h"
+#include "kickcat/Frame.h"
+#include "kickcat/MappingPlanner.h"
+
+namespace kickcat
+{
+    // Answer every frame as if all the slaves processed it: logical datagrams payload is sent back as is with the
+    // expected working counter of the PI frame, others datagrams get a working counter of 1.
+    // Unlike MockSocket, it does not allocate memory once built.
+    class LoopbackSocket : public AbstractSocket
+    {
+    public:
+        void open(std::string const&, microseconds) override {}
+        void close() noexcept override {}
+
+        int32_t write(uint8_t const* frame, int32_t frame_size) override
+        {
+            auto& answer = frames_[head_ % frames_.size()];
+            std::memcpy(answer.data(), frame, frame_size);
+            sizes_[head_ % frames_.size()] = frame_size;
+            ++head_;
+
+            uint8_t* pos = answer.data() + sizeof(EthernetHeader) + sizeof(EthercatHeader);
+            DatagramHeader* header;
+            do
+            {
+                header = reinterpret_cast<DatagramHeader*>(pos);
+                uint16_t* wkc = reinterpret_cast<uint16_t*>(pos + sizeof(DatagramHeader) + header->len);
+                *wkc = expectedWKC(header);
+                pos += datagram_size(header->len);
+            } while (header->multiple);
+
+            return frame_size;
+        }
+
+        int32_t read(uint8_t* frame, int32_t) override
+        {
+            auto& answer = frames_[tail_ % frames_.size()];
+            int32_t size = sizes_[tail_ % frames_.size()];
+            ++tail_;
+            std::memcpy(frame, answer.data(), size);
+            return size;
+        }
+
+        // logical datagrams answers are built from the PI layout
+        void setPlan(MappingPlanner::Plan const& plan) { plan_frames_ = plan.frames; }
+
+        // Add 'count' static I/O slaves exchanging 'pi_size' bytes each way, spread over 'groups' groups, then map
+        // them and answer their PI frames. A null iomap selects the zero copy mapping.
+        void mapSlaves(Bus& bus, int32_t count, uint16_t pi_size, int32_t groups, uint8_t* iomap)
+        {
+            outputs_sm_ = {0x1000, pi_size, 0x64, 0, 1, 3};
+            inputs_sm_  = {0x1100, pi_size, 0x20, 0, 1, 4};
+            for (int32_t i = 0; i < count; ++i)
+            {
+                Slave slave{};
+                slave.address = static_cast<uint16_t>(0x1000 + i);
+                slave.is_static_mapping = true;
+                slave.sii.syncManagers_ = {&outputs_sm_, &inputs_sm_};
+                slave.output = {nullptr, 0, pi_size, 0, 0, 0, false};
+                slave.input  = {nullptr, 0, pi_size, 1, 0, 0, false};
+                slave.group  = i % groups;
+                bus.slaves().push_back(slave);
+            }
+
+            if (iomap == nullptr)
+            {
+                bus.createZeroCopyMapping();
+            }
+            else
+            {
+                bus.createMapping(iomap);
+            }
+            setPlan(bus.mappingPlan());
+        }
+
+        // logical addresses of the sent logical datagrams (up to 64) since the last clear
+        std::array<uint32_t, 64> logical_addresses;
+        int32_t logical_datagrams{0};
+        void clearHistory() { logical_datagrams = 0; }
+
+    private:
+        uint16_t expectedWKC(DatagramHeader const* header)
+        {
+            for (auto const& frame : plan_frames_)
+            {
+                if (frame.address != header->address)
+                {
+                    continue;
+                }
+
+                uint16_t wkc = 1;
+                switch (header->command)
+                {
+                    case Command::LRD: { wkc = static_cast<uint16_t>(frame.inputs);                     break; }
+                    case Command::LWR: { wkc = static_cast<uint16_t>(frame.outputs);                    break; }
+                    case Command::LRW: { wkc = static_cast<uint16_t>(frame.inputs + 2 * frame.outputs); break; }
+                    default:           { return 1; }
+                }
+
+                if (logical_datagrams < static_cast<int32_t>(logical_addresses.size()))
+                {
+                    logical_addresses[logical_datagrams] = header->address;
+                }
+                ++logical_datagrams;
+                return wkc;
+            }
+            return 1;
+        }
+
+        eeprom::SyncManagerEntry outputs_sm_;
+        eeprom::SyncManagerEntry inputs_sm_;
+        std::vector<MappingPlanner::PIFrame> plan_frames_;
+        std::array<EthernetFrame, 32> frames_;
+        std::array<int32_t, 32> sizes_;
+        uint32_t head_{0};
+        uint32_t tail_{0};
+    };
+}
+
+#endif
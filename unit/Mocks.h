@@ -8,7 +8,7 @@ namespace kickcat
     {
     public:
         MOCK_METHOD(void,    open,  (std::string const& interface, microseconds timeout), (override));
-        MOCK_METHOD(void,    close, (), (noexcept override));
+        MOCK_METHOD(void,    close, (), (noexcept, override));
         MOCK_METHOD(int32_t, read,  (uint8_t* frame, int32_t frame_size), (override));
         MOCK_METHOD(int32_t, write, (uint8_t const* frame, int32_t frame_size), (override));
     };
@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+#include "kickcat/Bits.h"
+
+using namespace kickcat;
+
+TEST(Bits, mask)
+{
+    ASSERT_EQ(0x0,  bitMask(0));
+    ASSERT_EQ(0x1,  bitMask(1));
+    ASSERT_EQ(0xFF, bitMask(8));
+    ASSERT_EQ(0xFFFFFFFFFFFFFFFF, bitMask(64));
+}
+
+
+TEST(Bits, read)
+{
+    uint8_t data[4] = { 0xB4, 0x5A, 0xFF, 0x01 }; // 0x01FF5AB4
+
+    ASSERT_EQ(0x0,        readBits(data, 0, 2));
+    ASSERT_EQ(0x1,        readBits(data, 2, 1));
+    ASSERT_EQ(0xB,        readBits(data, 4, 4));
+    ASSERT_EQ(0xAB,       readBits(data, 4, 8));    // cross a byte boundary
+    ASSERT_EQ(0x5AB4,     readBits(data, 0, 16));
+    ASSERT_EQ(0x3FD6,     readBits(data, 10, 14));
+    ASSERT_EQ(0x01FF5AB4, readBits(data, 0, 32));
+    ASSERT_EQ(0x0,        readBits(data, 0, 0));
+}
+
+
+TEST(Bits, write)
+{
+    uint8_t data[4] = { 0, 0, 0, 0 };
+
+    writeBits(data, 2, 2, 0x3);
+    ASSERT_EQ(0x0C, data[0]);
+
+    writeBits(data, 6, 4, 0xF);    // cross a byte boundary
+    ASSERT_EQ(0xCC, data[0]);
+    ASSERT_EQ(0x03, data[1]);
+
+    writeBits(data, 2, 2, 0x0);    // clear bits without touching the neighbours
+    ASSERT_EQ(0xC0, data[0]);
+    ASSERT_EQ(0x03, data[1]);
+
+    writeBits(data, 8, 24, 0xFFA5A5A5); // extra bits are ignored
+    ASSERT_EQ(0xC0, data[0]);
+    ASSERT_EQ(0xA5, data[1]);
+    ASSERT_EQ(0xA5, data[2]);
+    ASSERT_EQ(0xA5, data[3]);
+
+    writeBits(data, 5, 7, 0x55);
+    ASSERT_EQ(0x55, readBits(data, 5, 7));
+    ASSERT_EQ(0x0,  readBits(data, 0, 5));
+    ASSERT_EQ(0xA,  readBits(data, 12, 4));
+}
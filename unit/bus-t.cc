@@ -3,6 +3,9 @@
 
 #include "kickcat/Bus.h"
 #include "Mocks.h"
+#include "LoopbackSocket.h"
+#include "CoESlavesSocket.h"
+#include "ESCSlavesSocket.h"
 
 using ::testing::Return;
 using ::testing::_;
@@ -18,6 +21,13 @@ struct SDOAnswer
     uint8_t payload[4];
 } __attribute__((__packed__));
 
+struct EepromAnswer
+{
+    uint16_t control;
+    uint32_t address;
+    uint32_t data[2];
+} __attribute__((__packed__));
+
 class BusTest : public testing::Test
 {
 public:
@@ -92,17 +102,13 @@ public:
 
     void addFetchEepromWord(uint32_t word)
     {
-        // address
-        checkSendFrame(Command::BWR);
+        // request address
+        checkSendFrame(Command::FPWR);
         handleReply();
 
-        // eeprom ready
+        // eeprom ready (4 bytes read) and fetch reply
         checkSendFrame(Command::FPRD);
-        handleReply<uint16_t>({0x0080}); // 0x8000 in LE
-
-        // fetch reply
-        checkSendFrame(Command::FPRD);
-        handleReply<uint32_t>({word});
+        handleReply<EepromAnswer>({{0x0000, 0, word, 0}});
     }
 
     void init_bus()
@@ -113,26 +119,16 @@ public:
         checkSendFrame(Command::BRD);
         handleReply();
 
-        // reset slaves
-        for (int i = 0; i < 9; ++i)
-        {
-            checkSendFrame(Command::BWR);
-            handleReply();
-        }
-
-        // set addresses
-        checkSendFrame(Command::APWR);
-        handleReply();
-
-        // request state: INIT
+        // reset slaves (9 datagrams), set addresses and request state INIT: one frame
         checkSendFrame(Command::BWR);
-        handleReply();
+        handleReply<uint8_t>(std::vector<uint8_t>(11, 0));
 
         // check state
         checkSendFrame(Command::FPRD);
         handleReply<uint8_t>({State::INIT});
 
         // fetch eeprom
+        addFetchEepromWord(0x000000A5);     // ESC configuration checksum
         addFetchEepromWord(0xCAFEDECA);     // vendor id
         addFetchEepromWord(0xA5A5A5A5);     // product code
         addFetchEepromWord(0x5A5A5A5A);     // revision number
@@ -140,7 +136,7 @@ public:
         addFetchEepromWord(0x01001000);     // mailbox rcv offset + size
         addFetchEepromWord(0x02002000);     // mailbox snd offset + size
         addFetchEepromWord(4);              // mailbox protocol: CoE
-        addFetchEepromWord(0);              // eeprom size
+        addFetchEepromWord(0x0000000F);     // eeprom size: 2 KiB
 
         // -- TxPDO
         addFetchEepromWord(0x00080032);     // section TxPDO, 16 bytes
@@ -167,13 +163,9 @@ public:
 
         addFetchEepromWord(0xFFFFFFFF);     // end of eeprom
 
-        // configue mailbox:
+        // configue mailbox and request state PREOP: one frame
         checkSendFrame(Command::FPWR);
-        handleReply();
-
-        // request state: PREOP
-        checkSendFrame(Command::BWR);
-        handleReply();
+        handleReply<uint8_t>({0, 0});
 
         // check state
         checkSendFrame(Command::FPRD);
@@ -234,6 +226,53 @@ public:
         }
     }
 
+    void addWriteSDO(uint16_t index, uint8_t subindex, uint32_t value, uint32_t abort_code = 0)
+    {
+        InSequence s;
+
+        checkSendFrame(Command::FPRD);
+        handleReply<uint8_t>({0, 0});// can write, nothing to read
+
+        EXPECT_CALL(*io, write(_,_))
+        .WillOnce(Invoke([this, index, subindex, value](uint8_t const* data, int32_t data_size)
+        {
+            Frame frame(data, data_size);
+            inflight = std::move(frame);
+            datagram = inflight.data() + sizeof(EthernetHeader) + sizeof(EthercatHeader);
+            header = reinterpret_cast<DatagramHeader*>(datagram);
+            payload = datagram + sizeof(DatagramHeader);
+
+            // expedited download
+            auto sdo = reinterpret_cast<mailbox::ServiceData const*>(payload + sizeof(mailbox::Header));
+            uint32_t written = 0;
+            std::memcpy(&written, sdo + 1, 4 - sdo->block_size);
+            EXPECT_EQ(Command::FPWR, header->command);
+            EXPECT_EQ(index,    sdo->index);
+            EXPECT_EQ(subindex, sdo->subindex);
+            EXPECT_EQ(value,    written);
+            return data_size;
+        }));
+        handleReply();
+
+        checkSendFrame(Command::FPRD);
+        handleReply<uint8_t>({0, 0x08});// can write, something to read
+
+        SDOAnswer answer;
+        answer.header.len = 10;
+        answer.header.type = mailbox::Type::CoE;
+        answer.sdo.service = CoE::Service::SDO_RESPONSE;
+        answer.sdo.command = CoE::SDO::response::DOWNLOAD;
+        answer.sdo.index = index;
+        answer.sdo.subindex = subindex;
+        if (abort_code != 0)
+        {
+            answer.sdo.command = CoE::SDO::request::ABORT;
+            std::memcpy(answer.payload, &abort_code, sizeof(abort_code));
+        }
+        checkSendFrame(Command::FPRD);
+        handleReply<SDOAnswer>({answer}); // read answer
+    }
+
 protected:
     std::shared_ptr<MockSocket> io{ std::make_shared<MockSocket>() };
     Bus bus{ io };
@@ -294,6 +333,8 @@ TEST_F(BusTest, logical_cmd)
     ASSERT_EQ(255, slave.input.size);
     ASSERT_EQ(48,  slave.output.bsize);
     ASSERT_EQ(383, slave.output.size);
+    ASSERT_EQ(32,  bus.mappingInputsSize());
+    ASSERT_EQ(48,  bus.mappingOutputsSize());
 
     // test logical read/write/read and write
 
@@ -322,7 +363,7 @@ TEST_F(BusTest, logical_cmd)
     logical_write = 0x1716151413121110;
     std::memcpy(slave.output.data, &logical_write, sizeof(int64_t));
     checkSendFrame(Command::LRW, logical_write);
-    handleReply<int64_t>({logical_read});
+    handleReply<int64_t>({logical_read}, 3); // read + write
     bus.processDataReadWrite([](){});
 
     for (int i = 0; i < 8; ++i)
@@ -345,6 +386,166 @@ TEST_F(BusTest, logical_cmd)
 }
 
 
+TEST_F(BusTest, logical_cmd_bit_packed)
+{
+    InSequence s;
+
+    // three slaves with 2 bits of inputs and 1 bit of outputs: they shall share the same logical byte
+    eeprom::PDOEntry tx_pdo{0x6000, 1, 0, 0, 2, 0};
+    eeprom::PDOEntry rx_pdo{0x7000, 1, 0, 0, 1, 0};
+    auto& slaves = bus.slaves();
+    slaves.resize(3, slaves.at(0));
+    for (auto& slave : slaves)
+    {
+        slave.sii.syncManagers_.clear();
+        slave.sii.RxPDO.clear();
+        slave.sii.TxPDO.clear();
+        slave.parseSII();
+
+        slave.supported_mailbox = eeprom::MailboxProtocol::None;
+        slave.sii.TxPDO = { &tx_pdo };
+        slave.sii.RxPDO = { &rx_pdo };
+    }
+
+    checkSendFrame(Command::FPWR);
+    handleReply<uint8_t>(std::vector<uint8_t>(12, 0));
+
+    uint8_t iomap[6];
+    bus.mappingPlanner().setPacking(MappingPlanner::BIT_PACKED);
+    bus.createMapping(iomap);
+
+    for (int32_t i = 0; i < 3; ++i)
+    {
+        ASSERT_EQ(0,     slaves[i].input.address);
+        ASSERT_EQ(i * 2, slaves[i].input.start_bit);
+        ASSERT_EQ(1,     slaves[i].input.bsize);
+        ASSERT_EQ(i * 2, slaves[i].output.start_bit);
+    }
+
+    uint8_t logical_read = 0b10'11'01;
+    checkSendFrame(Command::LRD);
+    handleReply<uint8_t>({logical_read}, 3);
+    bus.processDataRead([](){});
+    ASSERT_EQ(1, slaves[0].input.data[0]);
+    ASSERT_EQ(3, slaves[1].input.data[0]);
+    ASSERT_EQ(2, slaves[2].input.data[0]);
+
+    slaves[0].output.data[0] = 0x1;
+    slaves[1].output.data[0] = 0x0;
+    slaves[2].output.data[0] = 0x1;
+    uint8_t logical_write = 0b01'00'01;
+    checkSendFrame(Command::LWR, logical_write);
+    handleReply<uint8_t>({logical_write}, 3);
+    bus.processDataWrite([](){});
+}
+
+
+TEST_F(BusTest, pdo_signals)
+{
+    InSequence s;
+
+    eeprom::PDOEntry status_word  {0x6041, 0, 1, 0, 16, 0};
+    eeprom::PDOEntry position     {0x6064, 0, 2, 0, 32, 0};
+    eeprom::PDOEntry padding      {0x0000, 0, 0, 0, 4,  0};
+    eeprom::PDOEntry digital_input{0x6000, 1, 0, 0, 1,  0};
+    eeprom::PDOEntry control_word {0x6040, 0, 3, 0, 16, 0};
+
+    auto& slave = bus.slaves().at(0);
+    slave.supported_mailbox = eeprom::MailboxProtocol::None; // disable mailbox protocol to use SII PDO mapping
+    slave.sii.TxPDO = { &status_word, &position, &padding, &digital_input };
+    slave.sii.RxPDO = { &control_word };
+    char position_name[] = "Position actual value";
+    slave.sii.strings = { "", "Statusword", position_name, "Controlword" };
+
+    checkSendFrame(Command::FPWR);
+    handleReply<uint8_t>(std::vector<uint8_t>(4, 0));
+
+    uint8_t iomap[16];
+    bus.createMapping(iomap);
+
+    ASSERT_EQ(4, slave.input_entries.size());
+    ASSERT_EQ(1, slave.output_entries.size());
+    ASSERT_EQ(16, slave.input_entries[1].bit_offset);
+    ASSERT_EQ("Position actual value", slave.input_entries[1].name);
+    position_name[0] = 'X';    // the SII storage is reused: the entry keeps its name
+    ASSERT_EQ("Position actual value", slave.input_entries[1].name);
+    ASSERT_EQ(52, slave.input_entries[3].bit_offset);
+
+    // resolve once
+    Signal status  = bus.findSignal(slave, "Statusword");
+    Signal actual  = bus.findSignal(slave, 0x6064, 0);
+    Signal input   = bus.findSignal(slave, 0x6000, 1);
+    Signal control = bus.findSignal(slave, "Controlword");
+    ASSERT_EQ(16, actual.bit_offset);
+    ASSERT_EQ(32, actual.bit_size);
+    ASSERT_EQ(&slave.output.data, control.data);
+    ASSERT_THROW(bus.findSignal(slave, 0x6065, 0), Error);
+    ASSERT_THROW(bus.findSignal(slave, 0x0000, 0), Error);   // padding
+    ASSERT_THROW(bus.findSignal(slave, "Unknown"), Error);
+
+    // then access them each cycle
+    writeSignal(control, 0x000F);
+    checkSendFrame(Command::LRW, uint16_t{0x000F});
+    handleReply<uint64_t>({0x001000C0FFEE1234}, 3);
+    bus.processDataReadWrite([](){});
+
+    Signal signals[] = { status, actual, input };
+    uint64_t values[3];
+    readSignals(signals, 3, values);
+    ASSERT_EQ(0x1234,   values[0]);
+    ASSERT_EQ(0xC0FFEE, values[1]);
+    ASSERT_EQ(1,        values[2]);
+    ASSERT_EQ(0x000F,   readSignal(control));
+}
+
+
+TEST_F(BusTest, logical_cmd_zero_copy)
+{
+    InSequence s;
+
+    auto& slave = bus.slaves().at(0);
+    slave.supported_mailbox = eeprom::MailboxProtocol::None; // disable mailbox protocol to use SII PDO mapping
+
+    checkSendFrame(Command::FPWR);
+    handleReply<uint8_t>({2, 3, 4, 5});
+    bus.createZeroCopyMapping();
+
+    ASSERT_EQ(32, slave.input.bsize);
+    ASSERT_EQ(48, slave.output.bsize);
+
+    // outputs are written in the frame, answer is exposed without copy
+    int64_t logical_read  = 0x1011121314151617;
+    int64_t logical_write = 0x1716151413121110;
+    std::memcpy(slave.output.data, &logical_write, sizeof(int64_t));
+    uint8_t* previous_inputs = slave.input.data;
+
+    checkSendFrame(Command::LRW, logical_write);
+    handleReply<int64_t>({logical_read}, 3);
+    bus.processDataReadWrite([](){});
+
+    ASSERT_NE(previous_inputs, slave.input.data);
+    for (int i = 0; i < 8; ++i)
+    {
+        ASSERT_EQ(0x17 - i, slave.input.data[i]);
+    }
+    ASSERT_EQ(0, std::memcmp(slave.output.data, &logical_write, sizeof(int64_t)));
+
+    // invalid answer: last valid inputs are kept
+    uint8_t* valid_inputs = slave.input.data;
+    checkSendFrame(Command::LRD);
+    handleReply<int64_t>({0}, 0);
+    ASSERT_THROW(bus.processDataRead([](){ throw std::out_of_range(""); }), std::out_of_range);
+    ASSERT_EQ(valid_inputs, slave.input.data);
+    ASSERT_EQ(0x17, slave.input.data[0]);
+
+    logical_write = 0x0706050403020100;
+    std::memcpy(slave.output.data, &logical_write, sizeof(int64_t));
+    checkSendFrame(Command::LWR, logical_write);
+    handleReply<int64_t>({logical_write});
+    bus.processDataWrite([](){});
+}
+
+
 TEST_F(BusTest, AL_status_error)
 {
     auto& slave = bus.slaves().at(0);
@@ -564,3 +765,634 @@ TEST_F(BusTest, detect_mapping_CoE)
     ASSERT_EQ(5,  slave.output.bsize);
     ASSERT_EQ(10, slave.input.bsize);
 }
+
+
+TEST_F(BusTest, detect_mapping_CoE_remap)
+{
+    InSequence s;
+
+    auto& slave = bus.slaves().at(0);
+    bus.requestPDOMapping(slave, { {0x6040, 0, 16} }, { {0x6041, 0, 16}, {0x6064, 0, 32} });
+
+    addReadEmulatedSDO<uint8_t>(CoE::SM_COM_TYPE, { 2, SyncManagerType::Output, SyncManagerType::Input});
+
+    // outputs: SM0
+    addWriteSDO(CoE::SM_CHANNEL + 0, 0, 0);
+    addWriteSDO(CoE::RxPDO_MAPPING,  0, 0);
+    addWriteSDO(CoE::RxPDO_MAPPING,  1, 0x60400010);
+    addWriteSDO(CoE::RxPDO_MAPPING,  0, 1);
+    addWriteSDO(CoE::SM_CHANNEL + 0, 1, CoE::RxPDO_MAPPING);
+    addWriteSDO(CoE::SM_CHANNEL + 0, 0, 1);
+    addReadEmulatedSDO<uint16_t>(CoE::SM_CHANNEL + 0, { 1, CoE::RxPDO_MAPPING });
+    addReadEmulatedSDO<uint32_t>(CoE::RxPDO_MAPPING,  { 1, 0x60400010 });
+
+    // inputs: SM1
+    addWriteSDO(CoE::SM_CHANNEL + 1, 0, 0);
+    addWriteSDO(CoE::TxPDO_MAPPING,  0, 0);
+    addWriteSDO(CoE::TxPDO_MAPPING,  1, 0x60410010);
+    addWriteSDO(CoE::TxPDO_MAPPING,  2, 0x60640020);
+    addWriteSDO(CoE::TxPDO_MAPPING,  0, 2);
+    addWriteSDO(CoE::SM_CHANNEL + 1, 1, CoE::TxPDO_MAPPING);
+    addWriteSDO(CoE::SM_CHANNEL + 1, 0, 1);
+    addReadEmulatedSDO<uint16_t>(CoE::SM_CHANNEL + 1, { 1, CoE::TxPDO_MAPPING });
+    addReadEmulatedSDO<uint32_t>(CoE::TxPDO_MAPPING,  { 2, 0x60410010, 0x60640020 });
+
+    // SM/FMMU configuration
+    checkSendFrame(Command::FPWR);
+    handleReply<uint8_t>({2, 3});
+
+    uint8_t iomap[64];
+    bus.createMapping(iomap);
+
+    ASSERT_EQ(2, slave.output.bsize);
+    ASSERT_EQ(6, slave.input.bsize);
+    ASSERT_EQ(0x6064, slave.input_entries[1].index);
+    ASSERT_EQ(16,     slave.input_entries[1].bit_offset);
+    ASSERT_EQ(0x6040, slave.output_entries[0].index);
+
+    ASSERT_THROW(bus.requestPDOMapping(slave, std::vector<Slave::PDOObject>(255), {}), Error);
+}
+
+
+TEST_F(BusTest, detect_mapping_CoE_remap_refused)
+{
+    InSequence s;
+
+    auto& slave = bus.slaves().at(0);
+    bus.requestPDOMapping(slave, { {0x6040, 0, 16} }, { {0x6041, 0, 16} });
+
+    addReadEmulatedSDO<uint8_t>(CoE::SM_COM_TYPE, { 2, SyncManagerType::Output, SyncManagerType::Input});
+
+    // the slave does not accept the entry: the remap stops there
+    addWriteSDO(CoE::SM_CHANNEL + 0, 0, 0);
+    addWriteSDO(CoE::RxPDO_MAPPING,  0, 0);
+    addWriteSDO(CoE::RxPDO_MAPPING,  1, 0x60400010, 0x06040041);   // object cannot be mapped into the PDO
+
+    uint8_t iomap[64];
+    try
+    {
+        bus.createMapping(iomap);
+        FAIL();
+    }
+    catch (SDOError const& e)
+    {
+        ASSERT_EQ(0x06040041, e.code());
+        ASSERT_EQ(CoE::RxPDO_MAPPING, e.index());
+        ASSERT_EQ(1, e.subindex());
+    }
+}
+
+
+TEST(Bus, detect_mapping_CoE_concurrent)
+{
+    // mapping detection mailbox check frames for a given slaves number
+    auto detect = [](int32_t slaves_count)
+    {
+        auto socket = std::make_shared<CoESlavesSocket>();
+        Bus bus(socket);
+        bus.configureWaitLatency(0ns, 0ns);
+        for (int32_t i = 0; i < slaves_count; ++i)
+        {
+            socket->addSlave(bus.slaves(), static_cast<uint16_t>(0x1000 + i));
+        }
+
+        uint8_t iomap[1024];
+        bus.createMapping(iomap);
+
+        for (auto const& slave : bus.slaves())
+        {
+            EXPECT_EQ(3, slave.output.bsize);
+            EXPECT_EQ(7, slave.input.bsize);
+            EXPECT_EQ(0x6064, slave.input_entries.at(1).index);
+            EXPECT_EQ(16,     slave.input_entries.at(1).bit_offset);
+        }
+        return socket->mailbox_check_frames;
+    };
+
+    // slaves are read together: more slaves do not need more mailbox checks
+    int32_t frames = detect(1);
+    ASSERT_LT(0, frames);
+    ASSERT_EQ(frames, detect(8));
+}
+
+
+TEST(Bus, fetch_eeprom_pipelined)
+{
+    // init frames for a given chain: SII strings size and 8 bytes EEPROM reads
+    auto init = [](std::vector<std::pair<uint16_t, bool>> const& chain)
+    {
+        auto socket = std::make_shared<ESCSlavesSocket>();
+        for (std::size_t i = 0; i < chain.size(); ++i)
+        {
+            socket->addSlave(ESCSlavesSocket::createSII(0x6A5, 0x1000 + i, chain[i].first), chain[i].second);
+        }
+
+        Bus bus(socket);
+        bus.configureWaitLatency(0ns, 10ms);
+        bus.init();
+
+        EXPECT_EQ(chain.size(), bus.slaves().size());
+        for (std::size_t i = 0; i < chain.size(); ++i)
+        {
+            Slave const& slave = bus.slaves().at(i);
+            EXPECT_EQ(0x6A5,            slave.vendor_id);
+            EXPECT_EQ(0x1000 + i,       slave.product_code);
+            EXPECT_EQ(1,                slave.revision_number);
+            EXPECT_EQ(0x1000 + chain[i].first, slave.serial_number);
+            EXPECT_EQ(ESCSlavesSocket::MAILBOX_OUT,  slave.mailbox.recv_offset);
+            EXPECT_EQ(ESCSlavesSocket::MAILBOX_SIZE, slave.mailbox.recv_size);
+            EXPECT_EQ(ESCSlavesSocket::MAILBOX_IN,   slave.mailbox.send_offset);
+            EXPECT_EQ(ESCSlavesSocket::MAILBOX_SIZE, slave.mailbox.send_size);
+            EXPECT_EQ(eeprom::MailboxProtocol::CoE,  slave.supported_mailbox);
+            EXPECT_EQ(2048, slave.eeprom_size);
+            EXPECT_EQ(1,    slave.eeprom_version);
+            EXPECT_EQ(4,    slave.sii.syncManagers_.size());
+            EXPECT_EQ(0x1200, slave.sii.syncManagers_.at(3)->start_adress);
+        }
+        return socket->frames;
+    };
+
+    // 8 bytes reads halve the EEPROM requests
+    int32_t frames_4bytes = init({{64, false}});
+    int32_t frames_8bytes = init({{64, true}});
+    ASSERT_LT(frames_8bytes, frames_4bytes);
+
+    // slaves are fetched together: the longest SII gates the fetch, shorter ones do not add any request round
+    int32_t frames_longest = init({{64, false}, {64, false}, {64, false}, {64, false}});
+    ASSERT_EQ(frames_longest, init({{64, false}, {2, true}, {17, false}, {33, true}}));
+}
+
+
+TEST(Bus, fetch_eeprom_bounds)
+{
+    // no end category: the SII fills the whole EEPROM (2 KiB)
+    auto sii = ESCSlavesSocket::createSII(0x6A5, 0x1000, 0);
+    sii.resize(sii.size() - 2);
+    sii.resize(1024, 0);
+
+    auto socket = std::make_shared<ESCSlavesSocket>();
+    socket->addSlave(ESCSlavesSocket::createSII(0x6A5, 0x1001, 0));
+    socket->addSlave(sii);
+    Bus bus(socket);
+    bus.configureWaitLatency(0ns, 10ms);
+    bus.init();
+    ASSERT_EQ((1024 - eeprom::START_CATEGORY) / 2, bus.slaves().at(1).sii.buffer.size());
+    ASSERT_EQ(4, bus.slaves().at(1).sii.syncManagers_.size());
+
+    // fetched again: the SII replaces the previous one
+    std::size_t sii_size = bus.slaves().at(0).sii.buffer.size();
+    bus.init();
+    ASSERT_EQ(sii_size, bus.slaves().at(0).sii.buffer.size());
+    ASSERT_EQ(4, bus.slaves().at(0).sii.syncManagers_.size());
+}
+
+
+TEST(Bus, wait_for_state_batched)
+{
+    auto socket = std::make_shared<ESCSlavesSocket>();
+    for (int32_t i = 0; i < 20; ++i)
+    {
+        socket->addSlave(ESCSlavesSocket::createSII(0x6A5, i, 0));
+    }
+    Bus bus(socket);
+    bus.configureWaitLatency(100us, 10ms);
+    bus.init();
+
+    // every slave status in the same frames (up to 15 datagrams per frame): 2 frames instead of 20
+    int32_t frames = socket->frames;
+    bus.requestState(State::SAFE_OP);
+    bus.waitForState(State::SAFE_OP, 10ms);
+    ASSERT_EQ(frames + 1 + 2, socket->frames);
+
+    // the wait ends with the slowest slave
+    socket->setALLatency(7, 2ms);
+    frames = socket->frames;
+    nanoseconds start = since_epoch();
+    bus.requestState(State::OPERATIONAL);
+    bus.waitForState(State::OPERATIONAL, 100ms);
+    ASSERT_LE(2ms, elapsed_time(start));
+    int32_t polls = (socket->frames - frames - 1) / 2;
+    ASSERT_LT(1, polls);
+    ASSERT_GT(10, polls);     // adaptive interval: 0.1, 0.2, 0.4, 0.8, 1.6 ms...
+    for (auto const& slave : bus.slaves())
+    {
+        ASSERT_EQ(State::OPERATIONAL, slave.al_status);
+    }
+
+    // broadcast precheck: one datagram per round while every slave is fine
+    socket->setALLatency(7, 0ns);
+    bus.enableStatePrecheck(true);
+    int32_t datagrams = socket->datagrams;
+    bus.requestState(State::SAFE_OP);
+    bus.waitForState(State::SAFE_OP, 100ms);
+    ASSERT_EQ(datagrams + 2, socket->datagrams);
+    ASSERT_EQ(State::SAFE_OP, bus.slaves().at(19).al_status);
+
+    // an error is reported by the slave one by one read
+    socket->setALError(12, 0x0011);
+    bus.requestState(State::OPERATIONAL);
+    try
+    {
+        bus.waitForState(State::OPERATIONAL, 100ms);
+        FAIL();
+    }
+    catch (ErrorCode const& e)
+    {
+        ASSERT_EQ(0x0011, e.code());
+    }
+}
+
+
+TEST(Bus, mapped_mailbox_status)
+{
+    auto socket = std::make_shared<ESCSlavesSocket>();
+    for (int32_t i = 0; i < 20; ++i)
+    {
+        socket->addSlave(ESCSlavesSocket::createSII(0x6A5, i, 0));
+    }
+    socket->setFMMUs(7, 2);     // no FMMU left for the mailbox status
+    Bus bus(socket);
+    bus.configureWaitLatency(0ns, 10ms);
+    bus.init();
+
+    auto error = [](){ FAIL(); };
+    int32_t datagrams = socket->datagrams;
+    bus.checkMailboxes(error);
+    ASSERT_EQ(datagrams + 40, socket->datagrams);   // SM0 and SM1 status of every slave
+
+    uint8_t iomap[16];
+    bus.enableMappedMailboxStatus(true);
+    bus.createMapping(iomap);
+    ASSERT_FALSE(bus.slaves().at(7).is_mailbox_status_mapped);
+
+    // the whole bus in one datagram of 3 bytes, the slave without FMMU2 is checked on its own
+    datagrams = socket->datagrams;
+    bus.checkMailboxes(error);
+    ASSERT_EQ(datagrams + 3, socket->datagrams);
+    for (auto const& slave : bus.slaves())
+    {
+        ASSERT_FALSE(slave.mailbox.can_read);
+    }
+
+    // a written mailbox is full until checked again
+    uint32_t value = 0x12345678;
+    bus.asyncWriteSDO(bus.slaves().at(13), 0x6060, 0, &value, sizeof(value), 1s);
+    bus.sendWriteMessages(error);
+    bus.processAwaitingFrames();
+    ASSERT_FALSE(bus.slaves().at(13).mailbox.can_write);
+    bus.asyncWriteSDO(bus.slaves().at(13), 0x6060, 0, &value, sizeof(value), 1s);
+    bus.sendWriteMessages(error);
+    bus.processAwaitingFrames();
+    ASSERT_EQ(1, bus.slaves().at(13).mailbox.to_send.size());
+    for (int32_t i = 0; (i < 10) and bus.isSDORequestPending(); ++i)
+    {
+        bus.sendReadMessages(error);
+        bus.sendWriteMessages(error);
+        bus.sendMailboxesChecks(error);
+        bus.processAwaitingFrames();
+        bus.processSDORequests();
+    }
+    ASSERT_FALSE(bus.isSDORequestPending());
+    ASSERT_EQ(2, socket->sdoWrites(13).size());
+
+    // SDO traffic relies on it: SM0 status is read for the slave with a message to send only
+    datagrams = socket->datagrams;
+    bus.writeSDO(bus.slaves().at(13), 0x6060, 0, false, &value, sizeof(value));
+    ASSERT_EQ(3, socket->sdoWrites(13).size());
+    ASSERT_EQ(0x12345678, socket->sdoWrites(13).at(2).value);
+    ASSERT_GT(datagrams + 12, socket->datagrams);
+
+    uint32_t read = 0xFFFFFFFF;
+    uint32_t read_size = sizeof(read);
+    bus.readSDO(bus.slaves().at(19), 0x6061, 0, Bus::Access::PARTIAL, &read, &read_size);
+    ASSERT_EQ(0, read);
+}
+
+
+TEST(Bus, async_SDO)
+{
+    auto socket = std::make_shared<ESCSlavesSocket>();
+    for (int32_t i = 0; i < 3; ++i)
+    {
+        socket->addSlave(ESCSlavesSocket::createSII(0x6A5, i, 0));
+    }
+    Bus bus(socket);
+    bus.configureWaitLatency(0ns, 10ms);
+    bus.init();
+    auto error = [](){ FAIL(); };
+
+    uint32_t value = 0x12345678;
+    int32_t calls = 0;
+    auto count = [&calls](Bus::SDORequest const&) { ++calls; };
+    auto write = bus.asyncWriteSDO(bus.slaves().at(1), 0x6060, 0, &value, sizeof(value), 1s, count);
+    auto read  = bus.asyncReadSDO (bus.slaves().at(2), 0x6061, 0, 8, 1s, count);
+    auto lost  = bus.asyncReadSDO (bus.slaves().at(0), 0x6061, 0, 4, 1s, count);
+    value = 0;  // copied by the request
+    ASSERT_FALSE(write->isDone());
+
+    // never sent: expired
+    bus.processSDORequests(since_epoch() + 2s);
+    ASSERT_EQ(3, calls);
+    ASSERT_EQ(MessageStatus::TIMEDOUT, lost->status());
+    ASSERT_EQ(MessageStatus::TIMEDOUT, write->status());
+    ASSERT_TRUE(bus.slaves().at(1).mailbox.to_send.empty());
+    ASSERT_FALSE(bus.isSDORequestPending());
+
+    // cyclic exchange: read the answers, write the requests, check the mailboxes
+    calls = 0;
+    write = bus.asyncWriteSDO(bus.slaves().at(1), 0x6060, 0, &value, sizeof(value), 1s, count);
+    read  = bus.asyncReadSDO (bus.slaves().at(2), 0x6061, 0, 8, 1s, count);
+    for (int32_t i = 0; (i < 10) and bus.isSDORequestPending(); ++i)
+    {
+        bus.sendReadMessages(error);
+        bus.sendWriteMessages(error);
+        bus.sendMailboxesChecks(error);
+        bus.processAwaitingFrames();
+        bus.processSDORequests();
+    }
+    ASSERT_EQ(2, calls);
+    ASSERT_EQ(MessageStatus::SUCCESS, write->status());
+    ASSERT_EQ(MessageStatus::SUCCESS, read->status());
+    ASSERT_EQ(4, read->data.size());                // answer size
+    ASSERT_EQ(0, socket->sdoWrites(1).at(0).value);
+}
+
+
+TEST(Bus, async_SDO_reinit)
+{
+    auto socket = std::make_shared<ESCSlavesSocket>();
+    for (int32_t i = 0; i < 2; ++i)
+    {
+        socket->addSlave(ESCSlavesSocket::createSII(0x6A5, i, 0));
+    }
+    Bus bus(socket);
+    bus.configureWaitLatency(0ns, 10ms);
+    bus.init();
+    auto error = [](){ FAIL(); };
+
+    // one request sent and waiting for its answer, one still queued
+    std::vector<uint32_t> statuses;
+    auto callback = [&statuses](Bus::SDORequest const& request) { statuses.push_back(request.status()); };
+    auto sent   = bus.asyncReadSDO(bus.slaves().at(1), 0x6061, 0, 4, 1s, callback);
+    bus.sendWriteMessages(error);
+    bus.processAwaitingFrames();
+    auto queued = bus.asyncReadSDO(bus.slaves().at(1), 0x6062, 0, 4, 1s, callback);
+    ASSERT_FALSE(bus.slaves().at(1).mailbox.to_process.empty());
+
+    // the slaves are detected again: the requests are finished before
+    bus.init();
+    ASSERT_EQ(2, statuses.size());
+    ASSERT_EQ(MessageStatus::TIMEDOUT, statuses.at(0));
+    ASSERT_EQ(MessageStatus::TIMEDOUT, statuses.at(1));
+    ASSERT_EQ(MessageStatus::TIMEDOUT, sent->status());
+    ASSERT_EQ(MessageStatus::TIMEDOUT, queued->status());
+    ASSERT_FALSE(bus.isSDORequestPending());
+    bus.processSDORequests(since_epoch() + 2s);
+    ASSERT_EQ(2, statuses.size());
+}
+
+
+TEST(Bus, init_round_trips)
+{
+    auto init = [](int32_t slaves_count, int32_t& frames)
+    {
+        auto socket = std::make_shared<ESCSlavesSocket>();
+        for (int32_t i = 0; i < slaves_count; ++i)
+        {
+            socket->addSlave(ESCSlavesSocket::createSII(0x6A5, i, 0));
+        }
+        Bus bus(socket);
+        bus.configureWaitLatency(0ns, 10ms);
+        bus.init();
+        frames = socket->frames;
+        return bus.initRoundTrips();
+    };
+
+    // init datagrams are sent together: the round trips do not depend on the slaves count, only the frames do
+    int32_t one_frames;
+    int32_t many_frames;
+    int32_t one  = init(1,  one_frames);
+    int32_t many = init(40, many_frames);
+    ASSERT_EQ(one, many);
+    ASSERT_EQ(one, one_frames);
+    ASSERT_LT(many, many_frames);
+}
+
+
+TEST(Bus, async_state_requests)
+{
+    auto socket = std::make_shared<ESCSlavesSocket>();
+    for (int32_t i = 0; i < 4; ++i)
+    {
+        socket->addSlave(ESCSlavesSocket::createSII(0x6A5, i, 0));
+    }
+    Bus bus(socket);
+    bus.configureWaitLatency(0ns, 10ms);
+    bus.init();
+
+    auto& slaves = bus.slaves();
+    slaves[2].group = 1;
+    slaves[3].group = 1;
+
+    int32_t errors = 0;
+    auto error = [&errors]() { ++errors; };
+    auto step = [&]()
+    {
+        bus.sendStateRequests(error);
+        bus.processAwaitingFrames();
+    };
+
+    // one request per slave: written by FPWR, then polled
+    ASSERT_FALSE(bus.isStateRequestPending());
+    int32_t datagrams = socket->datagrams;
+    socket->setALLatency(1, 5ms);
+    bus.requestGroupState(0, State::SAFE_OP, 100ms);
+    ASSERT_EQ(Slave::StateRequest::NONE, slaves[2].state_request.status);
+    ASSERT_TRUE(bus.isStateRequestPending());
+    bus.sendStateRequests(error);
+    ASSERT_EQ(datagrams + 2, socket->datagrams);  // sent by the call itself
+    bus.processAwaitingFrames();
+    ASSERT_EQ(Slave::StateRequest::PENDING, slaves[0].state_request.status);
+    step();
+
+    // the fast slave does not wait the slow one
+    ASSERT_EQ(Slave::StateRequest::DONE,    slaves[0].state_request.status);
+    ASSERT_EQ(Slave::StateRequest::PENDING, slaves[1].state_request.status);
+    ASSERT_EQ(State::SAFE_OP, slaves[0].al_status);
+    ASSERT_EQ(State::PRE_OP,  bus.getCurrentState(slaves[2]));
+
+    // a failing slave and a timeout do not stall the others
+    socket->setALError(2, 0x001D);
+    socket->setALLatency(3, 1s);
+    bus.requestGroupState(1, State::SAFE_OP, 20ms);
+    nanoseconds start = since_epoch();
+    while (bus.isStateRequestPending())
+    {
+        ASSERT_GT(500ms, elapsed_time(start));
+        step();
+        sleep(100us);
+    }
+    ASSERT_EQ(Slave::StateRequest::DONE,    slaves[1].state_request.status);
+    ASSERT_EQ(Slave::StateRequest::FAILED,  slaves[2].state_request.status);
+    ASSERT_EQ(0x001D, slaves[2].al_status_code);
+    ASSERT_EQ(Slave::StateRequest::TIMEOUT, slaves[3].state_request.status);
+    ASSERT_EQ(State::SAFE_OP, bus.getCurrentState(slaves[1]));
+    ASSERT_EQ(0, errors);
+
+    // a lost slave keeps its request until the deadline
+    slaves[0].address = 0x7777;
+    bus.requestState(slaves[0], State::OPERATIONAL, 1ms);
+    step();
+    ASSERT_EQ(1, errors);
+    ASSERT_EQ(Slave::StateRequest::REQUESTED, slaves[0].state_request.status);
+    sleep(2ms);
+    step();
+    ASSERT_EQ(Slave::StateRequest::TIMEOUT, slaves[0].state_request.status);
+}
+
+
+TEST(Bus, multi_rate_groups)
+{
+    auto socket = std::make_shared<LoopbackSocket>();
+    Bus bus(socket);
+
+    uint8_t iomap[64];
+    socket->mapSlaves(bus, 4, 8, 2, iomap);     // drives in group 0, I/O terminals in group 1
+    bus.setGroupPeriod(0, 250us);
+    bus.setGroupPeriod(1, 4ms);
+    ASSERT_THROW(bus.setGroupPeriod(Bus::MAX_GROUPS, 1ms), Error);
+
+    // each group has its own PI frame and logical area
+    auto const& plan = bus.mappingPlan();
+    ASSERT_EQ(2,  plan.frames.size());
+    ASSERT_EQ(0,  plan.frames[0].address);
+    ASSERT_EQ(16, plan.frames[0].size);
+    ASSERT_EQ(2,  plan.frames[0].inputs);
+    ASSERT_EQ(MAX_ETHERCAT_PAYLOAD_SIZE, plan.frames[1].address);
+    ASSERT_EQ(0,  bus.slaves()[0].input.address);
+    ASSERT_EQ(8,  bus.slaves()[2].input.address);
+    ASSERT_EQ(MAX_ETHERCAT_PAYLOAD_SIZE,     bus.slaves()[1].output.address);
+    ASSERT_EQ(MAX_ETHERCAT_PAYLOAD_SIZE + 8, bus.slaves()[3].output.address);
+
+    auto error = [](){ THROW_ERROR("Invalid working counter"); };
+    auto cycle = [&](nanoseconds now)
+    {
+        socket->clearHistory();
+        bus.sendDueLogicalReadWrite(error, now);
+        bus.processAwaitingFrames();
+        return socket->logical_datagrams;
+    };
+
+    nanoseconds start = 1s;
+    ASSERT_EQ(2, cycle(start));     // every group is due at first
+    for (int32_t i = 1; i < 16; ++i)
+    {
+        ASSERT_EQ(1, cycle(start + i * 250us));
+        ASSERT_EQ(0, socket->logical_addresses[0]);
+    }
+    ASSERT_EQ(2, cycle(start + 4ms));
+    ASSERT_EQ(0, cycle(start + 4ms + 100us));
+
+    // late cycle: exchanged once, then the period restarts
+    ASSERT_EQ(2, cycle(start + 9ms));
+    ASSERT_EQ(1, cycle(start + 9ms + 250us));
+
+    // reads and writes are scheduled independently
+    socket->clearHistory();
+    bus.sendDueLogicalRead(error, start + 13ms);
+    bus.sendDueLogicalWrite(error, start + 13ms);
+    bus.sendDueLogicalRead(error, start + 13ms);
+    bus.processAwaitingFrames();
+    ASSERT_EQ(4, socket->logical_datagrams);
+
+    // non due API exchanges everything
+    socket->clearHistory();
+    bus.processDataReadWrite(error);
+    ASSERT_EQ(2, socket->logical_datagrams);
+}
+
+
+TEST(Bus, input_changes)
+{
+    for (bool zero_copy : {false, true})
+    {
+        auto socket = std::make_shared<LoopbackSocket>();
+        Bus bus(socket);
+
+        uint8_t iomap[64] = {0};
+        socket->mapSlaves(bus, 4, 8, 1, zero_copy ? nullptr : iomap);
+        bus.enableInputChanges(true);
+
+        // loopback: inputs are the sent outputs
+        auto error = [](){ THROW_ERROR("Invalid working counter"); };
+        auto cycle = [&]()
+        {
+            bus.processDataReadWrite(error);
+        };
+        cycle();
+        cycle();
+        bus.clearInputChanges();
+        cycle();
+        ASSERT_EQ(0, bus.inputChanges().at(0));
+
+        bus.slaves().at(2).output.data[5] = 0x42;
+        cycle();
+        ASSERT_EQ(1 << 2, bus.inputChanges().at(0));
+        ASSERT_TRUE(bus.isInputChanged(bus.slaves().at(2)));
+        ASSERT_FALSE(bus.isInputChanged(bus.slaves().at(1)));
+        ASSERT_EQ(0x42, bus.slaves().at(2).input.data[5]);
+
+        // flags are kept until cleared
+        cycle();
+        ASSERT_EQ(1 << 2, bus.inputChanges().at(0));
+        bus.clearInputChanges();
+        cycle();
+        ASSERT_EQ(0, bus.inputChanges().at(0));
+
+        bus.enableInputChanges(false);
+        bus.slaves().at(0).output.data[0] = 1;
+        cycle();
+        ASSERT_EQ(0, bus.inputChanges().at(0));
+        ASSERT_EQ(1, bus.slaves().at(0).input.data[0]);
+    }
+}
+
+
+TEST(Bus, outputs_delta_suppression)
+{
+    for (bool zero_copy : {false, true})
+    {
+        auto socket = std::make_shared<LoopbackSocket>();
+        Bus bus(socket);
+
+        uint8_t iomap[64] = {0};
+        socket->mapSlaves(bus, 4, 8, 2, zero_copy ? nullptr : iomap);   // drives in group 0, lamps in group 1
+        bus.setGroupOutputsRefresh(1, 10ms);
+        ASSERT_THROW(bus.setGroupOutputsRefresh(-1, 10ms), Error);
+        uint32_t const lamps_address = bus.mappingPlan().frames[1].address;
+
+        auto error = [](){ THROW_ERROR("Invalid working counter"); };
+        auto cycle = [&](nanoseconds now)
+        {
+            socket->clearHistory();
+            bus.sendDueLogicalWrite(error, now);
+            bus.processAwaitingFrames();
+            return socket->logical_datagrams;
+        };
+
+        ASSERT_EQ(2, cycle(0ms));   // first write
+        ASSERT_EQ(1, cycle(1ms));   // lamps unchanged: skipped
+        ASSERT_EQ(0, socket->logical_addresses[0]);
+
+        bus.slaves().at(3).output.data[0] = 1;
+        ASSERT_EQ(2, cycle(2ms));   // lamps changed
+        ASSERT_EQ(lamps_address, socket->logical_addresses[1]);
+        ASSERT_EQ(1, cycle(3ms));
+        ASSERT_EQ(1, cycle(11ms));
+        ASSERT_EQ(2, cycle(12ms));  // forced refresh
+        ASSERT_EQ(1, cycle(13ms));
+
+        bus.setGroupOutputsRefresh(1, 0ns);
+        ASSERT_EQ(2, cycle(14ms));  // suppression disabled
+    }
+}
@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "kickcat/Bus.h"
+#include "LoopbackSocket.h"
+
+using namespace kickcat;
+
+// Count heap allocations of the whole test program when enabled
+namespace
+{
+    std::atomic<bool>    count_allocations{false};
+    std::atomic<int32_t> allocations{0};
+}
+
+void* operator new(std::size_t size)
+{
+    if (count_allocations)
+    {
+        ++allocations;
+    }
+
+    void* ptr = std::malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+
+namespace
+{
+    constexpr int32_t PI_SIZE = 64; // per slave, inputs and outputs
+
+    int32_t errors = 0;
+
+    void exchange(bool zero_copy)
+    {
+        auto socket = std::make_shared<LoopbackSocket>();
+        Bus bus(socket);
+
+        uint8_t iomap[48 * PI_SIZE * 2];
+        socket->mapSlaves(bus, 48, PI_SIZE, 1, zero_copy ? nullptr : iomap);  // three PI frames
+        ASSERT_EQ(3, bus.mappingPlan().frames.size());
+
+        for (int32_t i = 0; i < 48; ++i)
+        {
+            std::memset(bus.slaves().at(i).output.data, i, PI_SIZE);
+        }
+
+        auto error = [](){ ++errors; };
+        errors = 0;
+        allocations = 0;
+        count_allocations = true;
+        for (int32_t i = 0; i < 10; ++i)
+        {
+            bus.processDataRead(error);
+            bus.processDataWrite(error);
+            bus.processDataReadWrite(error);
+        }
+        count_allocations = false;
+
+        ASSERT_EQ(0, errors);
+        ASSERT_EQ(0, allocations);
+
+        // loopback: slaves inputs are the sent outputs
+        for (int32_t i = 0; i < 48; ++i)
+        {
+            ASSERT_EQ(0, std::memcmp(bus.slaves().at(i).input.data, bus.slaves().at(i).output.data, PI_SIZE));
+            ASSERT_EQ(i, bus.slaves().at(i).input.data[PI_SIZE - 1]);
+        }
+    }
+}
+
+
+TEST(BusAllocation, counter)
+{
+    count_allocations = true;
+    allocations = 0;
+    delete new int32_t;
+    count_allocations = false;
+    ASSERT_EQ(1, allocations);
+}
+
+
+TEST(BusAllocation, cyclic_exchange)
+{
+    exchange(false);
+}
+
+
+TEST(BusAllocation, cyclic_exchange_zero_copy)
+{
+    exchange(true);
+}
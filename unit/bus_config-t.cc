@@ -0,0 +1,345 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+
+#include "kickcat/Bus.h"
+#include "kickcat/BusConfig.h"
+#include "ESCSlavesSocket.h"
+
+using namespace kickcat;
+
+class BusConfigTest : public testing::Test
+{
+public:
+    void TearDown() override
+    {
+        std::remove(path.c_str());
+    }
+
+    std::shared_ptr<ESCSlavesSocket> createSocket(std::vector<uint32_t> const& products)
+    {
+        auto socket = std::make_shared<ESCSlavesSocket>();
+        for (auto product : products)
+        {
+            socket->addSlave(ESCSlavesSocket::createSII(0x6A5, product, 100));
+        }
+        return socket;
+    }
+
+    void write(std::string const& content)
+    {
+        std::ofstream file(path);
+        file << content;
+    }
+
+protected:
+    std::string path{testing::TempDir() + "kickcat_bus_config.txt"};
+};
+
+
+TEST_F(BusConfigTest, save_load)
+{
+    BusConfig config;
+    SlaveConfig slave{};
+    slave.vendor_id       = 0x6A5;
+    slave.product_code    = 0x1234;
+    slave.revision_number = 2;
+    slave.serial_number   = 42;
+    slave.recv_offset = 0x1000;
+    slave.recv_size   = 128;
+    slave.send_offset = 0x1080;
+    slave.send_size   = 128;
+    slave.supported_mailbox = eeprom::MailboxProtocol::CoE;
+    slave.sync_managers = { {0x1000, 128, 0x26, 0, 1, 1}, {0x1100, 3, 0x64, 0, 1, 3} };
+    slave.output = {24, 2, { {0x6040, 0, 16}, {0x6060, 0, 8} }};
+    slave.input  = {4,  3, { {0x6000, 1, 1}, {0x0000, 0, 3} }};
+    slave.sdos   = { {0x1C12, 0, 1, 0}, {0x1600, 1, 4, 0x60400010} };
+    config.slaves = {slave, SlaveConfig{}};
+    config.save(path);
+
+    BusConfig loaded = BusConfig::load(path);
+    ASSERT_EQ(2, loaded.slaves.size());
+    SlaveConfig const& read = loaded.slaves[0];
+    ASSERT_EQ(0x1234, read.product_code);
+    ASSERT_EQ(42,     read.serial_number);
+    ASSERT_EQ(0x1080, read.send_offset);
+    ASSERT_EQ(eeprom::MailboxProtocol::CoE, read.supported_mailbox);
+    ASSERT_EQ(2,      read.sync_managers.size());
+    ASSERT_EQ(0x1100, read.sync_managers[1].start_adress);
+    ASSERT_EQ(0x64,   read.sync_managers[1].control_register);
+    ASSERT_EQ(24,     read.output.size);
+    ASSERT_EQ(2,      read.output.sync_manager);
+    ASSERT_EQ(0x6060, read.output.entries[1].index);
+    ASSERT_EQ(1,      read.input.entries[0].subindex);
+    ASSERT_EQ(3,      read.input.entries[1].bit_size);
+    ASSERT_EQ(2,      read.sdos.size());
+    ASSERT_EQ(0x60400010, read.sdos[1].value);
+    ASSERT_EQ(4,      read.sdos[1].size);
+    ASSERT_TRUE(loaded.slaves[1].sync_managers.empty());
+
+    // errors report the line number
+    auto errorLine = [this](std::string const& content)
+    {
+        write(content);
+        try
+        {
+            BusConfig::load(path);
+        }
+        catch (ErrorCode const& e)
+        {
+            return e.code();
+        }
+        return 0;
+    };
+    ASSERT_EQ(1, errorLine("mailbox 0x1000 128 0x1080 128 4\n"));
+    ASSERT_EQ(3, errorLine("# comment\nslave 1 2 3 4\nfmmu 0 0\n"));
+    ASSERT_EQ(2, errorLine("slave 1 2 3 4\ninput 12\n"));
+    ASSERT_EQ(2, errorLine("slave 1 2 3 4\ninput 12 abc\n"));
+    ASSERT_EQ(2, errorLine("slave 1 2 3 4\nsdo 0x1C12 0 8 0\n"));
+    ASSERT_THROW(BusConfig::load(path + ".missing"), Error);
+}
+
+
+TEST_F(BusConfigTest, init)
+{
+    // describe a discovered bus once
+    auto discovered = createSocket({0x100, 0x101, 0x102});
+    Bus reference(discovered);
+    reference.configureWaitLatency(0ns, 10ms);
+    reference.init();
+
+    BusConfig config = BusConfig::fromSlaves(reference.slaves());
+    config.slaves[1].output = {24, 2, { {0x6040, 0, 16}, {0x6060, 0, 8} }};
+    config.slaves[1].input  = {49, 3, { {0x6041, 0, 16}, {0x6064, 0, 32}, {0x6000, 1, 1} }};
+    config.slaves[1].sdos   = { {0x1C12, 0, 1, 0}, {0x1C12, 1, 2, 0x1601}, {0x1C12, 0, 1, 1} };
+    config.save(path);
+
+    // bring the bus up from the file
+    auto socket = createSocket({0x100, 0x101, 0x102});
+    Bus bus(socket);
+    bus.configureWaitLatency(0ns, 10ms);
+    bus.init(BusConfig::load(path));
+    ASSERT_LT(socket->frames, discovered->frames);
+
+    ASSERT_EQ(3, bus.slaves().size());
+    for (std::size_t i = 0; i < 3; ++i)
+    {
+        Slave const& slave = bus.slaves()[i];
+        Slave const& expected = reference.slaves()[i];
+        ASSERT_EQ(expected.product_code, slave.product_code);
+        ASSERT_EQ(expected.mailbox.recv_offset, slave.mailbox.recv_offset);
+        ASSERT_EQ(expected.mailbox.send_size,   slave.mailbox.send_size);
+        ASSERT_EQ(expected.supported_mailbox,   slave.supported_mailbox);
+        ASSERT_EQ(4, slave.sii.syncManagers_.size());
+        ASSERT_EQ(0x1200, slave.sii.syncManagers_[3]->start_adress);
+        ASSERT_TRUE(slave.is_static_mapping);
+    }
+
+    Slave const& drive = bus.slaves()[1];
+    ASSERT_EQ(49, drive.input.size);
+    ASSERT_EQ(7,  drive.input.bsize);
+    ASSERT_EQ(3,  drive.input.sync_manager);
+    ASSERT_EQ(3,  drive.output.bsize);
+    ASSERT_EQ(48, drive.input_entries.at(2).bit_offset);
+    ASSERT_EQ(0x6060, drive.output_entries.at(1).index);
+
+    auto const& sdos = socket->sdoWrites(1);
+    ASSERT_EQ(3, sdos.size());
+    ASSERT_EQ(0x1C12, sdos[1].index);
+    ASSERT_EQ(1,      sdos[1].subindex);
+    ASSERT_EQ(0x1601, sdos[1].value);
+    ASSERT_TRUE(socket->sdoWrites(0).empty());
+}
+
+
+TEST_F(BusConfigTest, from_slaves_remap)
+{
+    // a remapped slave with outputs only: the missing inputs SyncManager is not remapped
+    std::vector<Slave> slaves(1);
+    Slave& slave = slaves[0];
+    slave.is_pdo_remapped = true;
+    slave.rx_pdo_request = { {0x7000, 1, 8} };
+    slave.tx_pdo_request = { {0x6000, 1, 8} };
+    slave.output.size = 8;
+    slave.output.bsize = 1;
+    slave.output.sync_manager = 2;
+
+    BusConfig config = BusConfig::fromSlaves(slaves);
+    ASSERT_EQ(-1, config.slaves[0].input.sync_manager);
+    ASSERT_FALSE(config.slaves[0].sdos.empty());
+    for (auto const& sdo : config.slaves[0].sdos)
+    {
+        ASSERT_TRUE((sdo.index == CoE::SM_CHANNEL + 2) or (sdo.index == CoE::RxPDO_MAPPING));
+    }
+}
+
+
+TEST_F(BusConfigTest, init_mismatch)
+{
+    BusConfig config;
+    {
+        Bus reference(createSocket({0x100, 0x101, 0x102}));
+        reference.configureWaitLatency(0ns, 10ms);
+        reference.init();
+        config = BusConfig::fromSlaves(reference.slaves());
+    }
+
+    auto errorCode = [&config](std::vector<uint32_t> const& products)
+    {
+        auto socket = std::make_shared<ESCSlavesSocket>();
+        for (auto product : products)
+        {
+            socket->addSlave(ESCSlavesSocket::createSII(0x6A5, product, 100));
+        }
+        Bus bus(socket);
+        bus.configureWaitLatency(0ns, 10ms);
+        try
+        {
+            bus.init(config);
+        }
+        catch (ErrorCode const& e)
+        {
+            return e.code();
+        }
+        return -1;
+    };
+
+    ASSERT_EQ(2,  errorCode({0x100, 0x101, 0x999}));  // position of the unexpected slave
+    ASSERT_EQ(2,  errorCode({0x100, 0x101}));         // detected slaves
+    ASSERT_EQ(-1, errorCode({0x100, 0x101, 0x102}));
+}
+
+
+TEST_F(BusConfigTest, init_invalid)
+{
+    BusConfig config;
+    {
+        Bus reference(createSocket({0x100, 0x101}));
+        reference.configureWaitLatency(0ns, 10ms);
+        reference.init();
+        config = BusConfig::fromSlaves(reference.slaves());
+    }
+    config.slaves[0].sdos  = { {0x1C12, 0, 1, 0} };
+    config.slaves[1].input = {16, 3, { {0x6041, 0, 16} }};
+    config.slaves[1].sdos  = { {0x1C13, 0, 1, 0}, {0x1A00, 0, 1, 0}, {0x1C13, 0, 1, 1} };
+
+    // a startup SDO refused by the slave, while another slave has not answered yet
+    auto socket = createSocket({0x100, 0x101});
+    socket->setSDOAbort(1, 0x1A00, 0x08000022);
+    socket->setMailboxMute(0);
+    Bus bus(socket);
+    bus.configureWaitLatency(0ns, 10ms);
+    try
+    {
+        bus.init(config);
+        FAIL();
+    }
+    catch (SDOError const& e)
+    {
+        ASSERT_EQ(0x08000022, e.code());
+        ASSERT_EQ(0x1A00, e.index());
+    }
+    ASSERT_EQ(1, socket->sdoWrites(1).size());      // stopped at the refused one
+    ASSERT_EQ(1, bus.slaves()[0].mailbox.to_process.size());   // cancelled: only the emergency reception is left
+    ASSERT_TRUE(bus.slaves()[0].mailbox.to_send.empty());
+
+    // mapping on a SyncManager the slave does not have
+    config.slaves[0].sdos.clear();
+    config.slaves[1].sdos.clear();
+    config.slaves[1].input.sync_manager = 4;
+    Bus other(createSocket({0x100, 0x101}));
+    other.configureWaitLatency(0ns, 10ms);
+    try
+    {
+        other.init(config);
+        FAIL();
+    }
+    catch (ErrorCode const& e)
+    {
+        ASSERT_EQ(1, e.code());
+    }
+}
+
+
+TEST_F(BusConfigTest, warm_attach)
+{
+    BusConfig config;
+    {
+        Bus reference(createSocket({0x100, 0x101, 0x102}));
+        reference.configureWaitLatency(0ns, 10ms);
+        reference.init();
+        config = BusConfig::fromSlaves(reference.slaves());
+    }
+    config.slaves[1].output = {24, 2, { {0x6040, 0, 16}, {0x6060, 0, 8} }};
+    config.slaves[1].input  = {48, 3, { {0x6041, 0, 16}, {0x6064, 0, 32} }};
+    config.slaves[2].input  = {8,  3, { {0x6000, 1, 8} }};
+
+    // running bus
+    auto socket = createSocket({0x100, 0x101, 0x102});
+    uint8_t iomap[64];
+    Bus running(socket);
+    running.configureWaitLatency(0ns, 10ms);
+    running.init(config);
+    int32_t init_frames = socket->frames;
+    running.createMapping(iomap);
+    running.requestState(State::SAFE_OP);
+    running.waitForState(State::SAFE_OP, 10ms);
+    running.requestState(State::OPERATIONAL);
+    running.waitForState(State::OPERATIONAL, 10ms);
+
+    // master restart: the slaves stay in OP
+    uint8_t attached_iomap[64];
+    int32_t frames = socket->frames;
+    Bus bus(socket);
+    bus.configureWaitLatency(0ns, 10ms);
+    bus.attach(config, attached_iomap);
+    ASSERT_LT(socket->frames - frames, init_frames);
+    ASSERT_EQ(bus.initRoundTrips(), socket->frames - frames);
+    for (std::size_t i = 0; i < 3; ++i)
+    {
+        Slave const& slave = bus.slaves()[i];
+        Slave const& expected = running.slaves()[i];
+        ASSERT_EQ(State::OPERATIONAL, slave.al_status);
+        ASSERT_EQ(expected.input.address,  slave.input.address);
+        ASSERT_EQ(expected.output.address, slave.output.address);
+        ASSERT_EQ(State::OPERATIONAL, bus.getCurrentState(bus.slaves()[i]));
+    }
+    for (std::size_t i = 1; i < 3; ++i)     // mapped slaves
+    {
+        ASSERT_EQ(running.slaves()[i].input.data - iomap, bus.slaves()[i].input.data - attached_iomap);
+    }
+    ASSERT_EQ(running.slaves()[1].output.data - iomap, bus.slaves()[1].output.data - attached_iomap);
+    ASSERT_EQ(running.mappingPlan().frames.size(), bus.mappingPlan().frames.size());
+    ASSERT_EQ(0x6064, bus.slaves()[1].input_entries.at(1).index);
+
+    auto errorCode = [&](BusConfig const& expected, MappingPlanner::Layout layout)
+    {
+        Bus other(socket);
+        other.configureWaitLatency(0ns, 10ms);
+        other.mappingPlanner().setLayout(layout);
+        try
+        {
+            other.attach(expected, attached_iomap);
+        }
+        catch (ErrorCode const& e)
+        {
+            return e.code();
+        }
+        return -1;
+    };
+
+    // another mapping on the client side: the slaves FMMUs do not match
+    BusConfig remapped = config;
+    remapped.slaves[2].input = {16, 3, { {0x6000, 1, 16} }};
+    ASSERT_EQ(2,  errorCode(remapped, running.mappingPlan().layout));
+    ASSERT_EQ(-1, errorCode(config,   running.mappingPlan().layout));
+
+    // another slave
+    BusConfig replaced = config;
+    replaced.slaves[1].serial_number += 1;
+    ASSERT_EQ(1, errorCode(replaced, running.mappingPlan().layout));
+
+    // bus reset by another master (PRE_OP, FMMUs cleared): init() required
+    running.init(config);
+    ASSERT_EQ(1, errorCode(config, running.mappingPlan().layout));
+}
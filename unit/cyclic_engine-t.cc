@@ -0,0 +1,227 @@
+#include <gtest/gtest.h>
+#include <cerrno>
+
+#include "kickcat/CyclicEngine.h"
+#include "LoopbackSocket.h"
+#include "ESCSlavesSocket.h"
+
+using namespace kickcat;
+
+class CyclicEngineTest : public testing::Test
+{
+public:
+    void SetUp() override
+    {
+        socket->mapSlaves(bus, 2, 4, 1, iomap);
+    }
+
+protected:
+    std::shared_ptr<LoopbackSocket> socket{ std::make_shared<LoopbackSocket>() };
+    Bus bus{ socket };
+    uint8_t iomap[16] = {0};
+};
+
+
+TEST(Time, sleep_until)
+{
+    nanoseconds deadline = monotonic_time() + 2ms;
+    sleep_until(deadline);
+    ASSERT_GE(monotonic_time(), deadline);
+    sleep_until(deadline - 1s); // already passed: no wait
+
+    errno = 0;
+    try
+    {
+        sleep_until(-1ns);      // invalid time
+        FAIL();
+    }
+    catch (std::system_error const& e)
+    {
+        ASSERT_EQ(EINVAL, e.code().value());
+    }
+}
+
+
+TEST_F(CyclicEngineTest, run)
+{
+    ASSERT_THROW(CyclicEngine(bus, 0ns), Error);
+
+    CyclicEngine engine(bus, 1ms);
+    ASSERT_THROW(engine.setRealTime(-1), Error);
+
+    int32_t pre_send = 0;
+    int32_t post_receive = 0;
+    auto& slave = bus.slaves().at(1);
+    engine.setPreSend([&]()
+    {
+        ++pre_send;
+        slave.output.data[0] = static_cast<uint8_t>(pre_send);
+    });
+    engine.setPostReceive([&]()
+    {
+        ++post_receive;
+        ASSERT_EQ(pre_send, slave.input.data[0]); // loopback: inputs of the same cycle
+    });
+
+    nanoseconds start = monotonic_time();
+    engine.run(10);
+    nanoseconds duration = monotonic_time() - start;
+
+    ASSERT_EQ(10, pre_send);
+    ASSERT_EQ(10, post_receive);
+    ASSERT_GE(duration, 10ms); // absolute deadlines: one period per cycle
+
+    auto const& stats = engine.statistics();
+    ASSERT_EQ(10, stats.cycles);
+    ASSERT_EQ(0,  stats.errors);
+    ASSERT_LT(0ns, stats.max_cycle_time);
+}
+
+
+TEST_F(CyclicEngineTest, overrun_and_stop)
+{
+    CyclicEngine engine(bus, 1ms);
+    engine.setPreSend([&]()
+    {
+        if (engine.statistics().cycles == 2)
+        {
+            sleep(3ms);         // miss the next deadlines
+        }
+    });
+    engine.setPostReceive([&]()
+    {
+        if (engine.statistics().cycles == 4)
+        {
+            engine.stop();
+        }
+    });
+
+    engine.run();
+    auto const& stats = engine.statistics();
+    ASSERT_EQ(5, stats.cycles);
+    ASSERT_EQ(1, stats.overruns);
+    ASSERT_LT(0ns, stats.last_overrun);
+    ASSERT_GE(stats.max_cycle_time, 3ms);
+
+    engine.resetStatistics();
+    ASSERT_EQ(0, engine.statistics().cycles);
+}
+
+
+TEST_F(CyclicEngineTest, input_to_output_latency)
+{
+    CyclicEngine engine(bus, 5ms);
+    ASSERT_THROW(engine.setPipelined(true, 5ms), Error);
+
+    // classic mode: outputs computed from the inputs are sent with the next cycle
+    int32_t datagrams = 0;
+    engine.setPreSend([&]()                { socket->clearHistory(); });
+    engine.setPostReceive([&]()            { datagrams = socket->logical_datagrams; });
+    engine.run(3);
+    ASSERT_EQ(1, datagrams);    // LRW
+    ASSERT_GE(engine.timestamps().latency(), 4ms);
+    ASSERT_GE(engine.statistics().max_io_latency, 4ms);
+
+    // pipelined mode: outputs are sent right after the inputs reception
+    engine.setPipelined(true);
+    engine.resetStatistics();
+    engine.run(3);
+    ASSERT_EQ(2, socket->logical_datagrams);    // LRD, then LWR
+    ASSERT_LT(engine.statistics().max_io_latency, 2ms);
+    ASSERT_LT(0ns, engine.timestamps().inputs);
+    ASSERT_LE(engine.timestamps().inputs, engine.timestamps().outputs);
+
+    // phase offset: outputs are sent at a fixed time of the cycle
+    engine.setPipelined(true, 2ms);
+    engine.run(3);
+    ASSERT_GE(engine.timestamps().outputs - engine.timestamps().deadline, 2ms);
+    ASSERT_EQ(0, engine.statistics().errors);
+}
+
+
+TEST(CyclicEngine, groups)
+{
+    auto socket = std::make_shared<LoopbackSocket>();
+    Bus bus(socket);
+    uint8_t iomap[32] = {0};
+    socket->mapSlaves(bus, 2, 4, 2, iomap);
+    bus.setGroupPeriod(1, 2ms);
+
+    // scheduled on the wall clock first: the engine cycles deadlines take over
+    auto error = [](){ FAIL(); };
+    bus.sendDueLogicalReadWrite(error);
+    bus.processAwaitingFrames();
+
+    CyclicEngine engine(bus, 1ms);
+    int32_t datagrams = 0;
+    engine.setPreSend([&]()     { socket->clearHistory(); });
+    engine.setPostReceive([&]() { datagrams += socket->logical_datagrams; });
+    engine.run(6);
+    ASSERT_EQ(0, engine.statistics().errors);
+    ASSERT_EQ(6 + 3, datagrams);    // slow group every other cycle
+}
+
+
+TEST(CyclicEngine, mailboxes)
+{
+    auto socket = std::make_shared<ESCSlavesSocket>();
+    for (int32_t i = 0; i < 20; ++i)
+    {
+        socket->addSlave(ESCSlavesSocket::createSII(0x6A5, i, 0));
+    }
+    Bus bus(socket);
+    bus.configureWaitLatency(0ns, 10ms);
+    bus.init();
+    uint8_t iomap[16];
+    bus.createMapping(iomap);
+
+    // 5 SDO per slave, all queued at once
+    int32_t done = 0;
+    int32_t failed = 0;
+    for (auto& slave : bus.slaves())
+    {
+        for (uint32_t i = 0; i < 5; ++i)
+        {
+            uint32_t value = (uint32_t{slave.address} << 8) | i;
+            bus.asyncWriteSDO(slave, 0x2000, static_cast<uint8_t>(i), &value, sizeof(value), 100ms,
+            [&](Bus::SDORequest const& request)
+            {
+                ++done;
+                failed += (request.status() != MessageStatus::SUCCESS);
+            });
+        }
+        bus.asyncReadSDO(slave, 0x2001, 0, 4, 100ms, [&](Bus::SDORequest const& request)
+        {
+            ++done;
+            failed += (request.status() != MessageStatus::SUCCESS) or (request.data.size() != 4);
+        });
+    }
+    ASSERT_TRUE(bus.isSDORequestPending());
+
+    CyclicEngine engine(bus, 1ms);
+    engine.enableMailboxes(true);
+    engine.setPostReceive([&]()
+    {
+        if (not bus.isSDORequestPending())
+        {
+            engine.stop();
+        }
+    });
+    engine.run(100);
+
+    // one message per slave and per cycle (read and write overlap): the whole bus progresses together
+    ASSERT_EQ(20 * 6, done);
+    ASSERT_EQ(0, failed);
+    ASSERT_GT(20, engine.statistics().cycles);
+    ASSERT_EQ(0, engine.statistics().errors);
+    for (int32_t position = 0; position < 20; ++position)
+    {
+        auto const& sdos = socket->sdoWrites(position);
+        ASSERT_EQ(5, sdos.size());
+        for (uint32_t i = 0; i < 5; ++i)
+        {
+            ASSERT_EQ(i, sdos[i].subindex);     // in order
+            ASSERT_EQ((uint32_t{bus.slaves().at(position).address} << 8) | i, sdos[i].value);
+        }
+    }
+}
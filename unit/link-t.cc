@@ -363,3 +363,80 @@ TEST_F(LinkTest, process_datagrams_old_frame)
     ASSERT_EQ(2, error_callback_counter);
 }
 
+
+
+TEST_F(LinkTest, zero_copy_frame)
+{
+    ZeroCopyFrame& zero_copy = link.createZeroCopyFrame(0x100, 4);
+    ASSERT_EQ(0x100, zero_copy.address());
+    ASSERT_EQ(4,     zero_copy.dataSize());
+
+    uint32_t outputs = 0xCAFEDECA;
+    std::memcpy(zero_copy.payload(), &outputs, sizeof(outputs));
+
+    {
+        InSequence s;
+
+        checkSendFrame(1); // pending datagram is sent first
+        EXPECT_CALL(*io, write(_,_))
+        .WillOnce(Invoke([&](uint8_t const* data, int32_t data_size)
+        {
+            Frame frame(data, data_size);
+            auto [header, payload, wkc] = frame.nextDatagram();
+            EXPECT_EQ(Command::LRW, header->command);
+            EXPECT_EQ(1, header->index);
+            EXPECT_EQ(0x100, header->address);
+            EXPECT_EQ(0, std::memcmp(payload, &outputs, sizeof(outputs)));
+            return data_size;
+        }));
+
+        EXPECT_CALL(*io, read(_,_))
+        .WillOnce(Invoke([](uint8_t* data, int32_t)
+        {
+            Frame frame;
+            frame.addDatagram(0, Command::BRD,  0, nullptr, 1);
+            int32_t toWrite = frame.finalize();
+            std::memcpy(data, frame.data(), toWrite);
+            return toWrite;
+        }));
+
+        EXPECT_CALL(*io, read(_,_))
+        .WillOnce(Invoke([](uint8_t* data, int32_t)
+        {
+            uint32_t inputs = 0x12345678;
+            Frame frame;
+            frame.addDatagram(1, Command::LRW,  0x100, &inputs, sizeof(inputs));
+            int32_t toWrite = frame.finalize();
+            std::memcpy(data, frame.data(), toWrite);
+            return toWrite;
+        }));
+    }
+
+    uint8_t payload;
+    addDatagram(payload);
+
+    uint8_t const* answer = nullptr;
+    link.addDatagram(zero_copy, Command::LRW,
+        [&](DatagramHeader const*, uint8_t const* data, uint16_t)
+        {
+            answer = data;
+            zero_copy.swap(data);
+            return false;
+        },
+        [&](){ error_callback_counter++; });
+    link.processDatagrams();
+
+    ASSERT_EQ(1, process_callback_counter);
+    ASSERT_EQ(0, error_callback_counter);
+    ASSERT_EQ(answer, zero_copy.front()); // answer read directly in the frame buffer
+    ASSERT_EQ(0x12345678, *reinterpret_cast<uint32_t const*>(zero_copy.front()));
+    ASSERT_EQ(0, std::memcmp(zero_copy.payload(), &outputs, sizeof(outputs)));
+
+    // answer received elsewhere is copied
+    uint32_t other = 0xA5A5A5A5;
+    zero_copy.swap(reinterpret_cast<uint8_t const*>(&other));
+    ASSERT_NE(answer, zero_copy.front());
+    ASSERT_EQ(0xA5A5A5A5, *reinterpret_cast<uint32_t const*>(zero_copy.front()));
+
+    link.releaseZeroCopyFrames();
+}
@@ -293,3 +293,33 @@ TEST_F(MailboxTest, SDO_download_abort)
 
     ASSERT_EQ(0x06010000, message->status());
 }
+
+
+TEST_F(MailboxTest, cancel)
+{
+    int32_t data = 0;
+    uint32_t data_size = sizeof(data);
+    auto sent    = mailbox.createSDO(0x1018, 1, false, CoE::SDO::request::UPLOAD, &data, &data_size);
+    auto waiting = mailbox.createSDO(0x1018, 2, false, CoE::SDO::request::UPLOAD, &data, &data_size);
+    auto other   = mailbox.createSDO(0x1018, 3, false, CoE::SDO::request::UPLOAD, &data, &data_size);
+    mailbox.send();
+
+    mailbox.cancel(sent, MessageStatus::TIMEDOUT);
+    mailbox.cancel(waiting, MessageStatus::TIMEDOUT);  // not sent yet
+    ASSERT_EQ(MessageStatus::TIMEDOUT, waiting->status());
+    ASSERT_TRUE(mailbox.to_process.empty());
+    ASSERT_EQ(1, mailbox.to_send.size());
+    ASSERT_EQ(other, mailbox.to_send.front());
+
+    // late answer
+    header->type = mailbox::Type::CoE;
+    sdo->transfer_type = 1;
+    sdo->command = CoE::SDO::request::UPLOAD;
+    sdo->service = CoE::Service::SDO_RESPONSE;
+    sdo->index = 0x1018;
+    sdo->subindex = 1;
+    *static_cast<int32_t*>(payload) = 0xCAFEDECA;
+    ASSERT_FALSE(mailbox.receive(raw_message));
+    ASSERT_EQ(0, data);
+    ASSERT_EQ(MessageStatus::TIMEDOUT, sent->status());
+}
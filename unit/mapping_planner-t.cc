@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+#include "kickcat/MappingPlanner.h"
+#include "kickcat/Error.h"
+
+using namespace kickcat;
+
+TEST(MappingPlanner, overlapped)
+{
+    MappingPlanner planner;
+    auto plan = planner.plan({ {16, 8}, {0, 24}, {8, 0}, {0, 0} });
+
+    ASSERT_EQ(MappingPlanner::OVERLAPPED, plan.layout);
+    ASSERT_EQ(1, plan.frames.size());
+    ASSERT_EQ(0, plan.frames[0].address);
+    ASSERT_EQ(6, plan.frames[0].size);
+    ASSERT_EQ(2, plan.frames[0].inputs);
+    ASSERT_EQ(2, plan.frames[0].outputs);
+
+    // slaves order is kept
+    ASSERT_EQ(0,  plan.inputs[0].address);
+    ASSERT_EQ(0,  plan.outputs[0].address);
+    ASSERT_EQ(-1, plan.inputs[1].frame);
+    ASSERT_EQ(2,  plan.outputs[1].address);
+    ASSERT_EQ(5,  plan.inputs[2].address);
+    ASSERT_EQ(-1, plan.outputs[2].frame);
+    ASSERT_EQ(-1, plan.inputs[3].frame);
+    ASSERT_EQ(-1, plan.outputs[3].frame);
+}
+
+
+TEST(MappingPlanner, separated_for_read_then_write)
+{
+    MappingPlanner planner;
+    std::vector<MappingPlanner::Entry> slaves{ {1024, 512}, {0, 1536}, {512, 0} };
+
+    auto lrw = planner.plan(slaves);
+    ASSERT_EQ(MappingPlanner::OVERLAPPED, lrw.layout);
+
+    planner.setExchange(MappingPlanner::READ_THEN_WRITE);
+    auto plan = planner.plan(slaves);
+    ASSERT_EQ(MappingPlanner::SEPARATED, plan.layout);
+    ASSERT_EQ(2, plan.frames.size());
+    ASSERT_EQ(2, plan.datagrams);
+    ASSERT_EQ(1, plan.ethernet_frames);
+
+    ASSERT_EQ(192, plan.frames[0].size);
+    ASSERT_EQ(2,   plan.frames[0].inputs);
+    ASSERT_EQ(0,   plan.frames[0].outputs);
+    ASSERT_EQ(0,   plan.inputs[0].address);
+    ASSERT_EQ(128, plan.inputs[2].address);
+
+    ASSERT_EQ(256,  plan.frames[1].size);
+    ASSERT_EQ(MAX_ETHERCAT_PAYLOAD_SIZE, plan.frames[1].address);
+    ASSERT_EQ(MAX_ETHERCAT_PAYLOAD_SIZE, plan.outputs[0].address);
+    ASSERT_EQ(MAX_ETHERCAT_PAYLOAD_SIZE + 64, plan.outputs[1].address);
+
+    planner.setLayout(MappingPlanner::OVERLAPPED);
+    auto overlapped = planner.plan(slaves);
+    ASSERT_EQ(MappingPlanner::OVERLAPPED, overlapped.layout);
+    ASSERT_LT(plan.wire_time, overlapped.wire_time);
+}
+
+
+TEST(MappingPlanner, minimize_frames)
+{
+    MappingPlanner planner;
+    std::vector<MappingPlanner::Entry> slaves{ {1600, 0}, {1600, 0}, {1600, 0}, {1600, 0}, {8000, 0}, {8000, 0} };
+
+    // in order, small slaves fill the first frame and each big one needs its own: sorting them saves a frame
+    auto plan = planner.plan(slaves);
+    ASSERT_EQ(2, plan.frames.size());
+    ASSERT_EQ(1400, plan.frames[0].size);
+    ASSERT_EQ(1400, plan.frames[1].size);
+}
+
+
+TEST(MappingPlanner, pinned_slaves)
+{
+    MappingPlanner planner;
+    planner.pin(1, 1);
+    auto plan = planner.plan({ {8, 8}, {8, 8}, {8, 8} });
+
+    ASSERT_EQ(2, plan.frames.size());
+    ASSERT_EQ(0, plan.inputs[0].frame);
+    ASSERT_EQ(1, plan.inputs[1].frame);
+    ASSERT_EQ(0, plan.inputs[2].frame);
+    ASSERT_EQ(1, plan.inputs[2].address);
+    ASSERT_EQ(MAX_ETHERCAT_PAYLOAD_SIZE, plan.inputs[1].address);
+
+    // empty frames are dropped: the pins give the order, not the plan index
+    planner.clearPins();
+    planner.pin(0, 5);
+    planner.pin(1, 3);
+    plan = planner.plan({ {8000, 0}, {8000, 0} });
+    ASSERT_EQ(2, plan.frames.size());
+    ASSERT_EQ(1, plan.inputs[0].frame);
+    ASSERT_EQ(0, plan.inputs[1].frame);
+
+    planner.clearPins();
+    planner.pin(0, 0);
+    planner.pin(1, 0);
+    ASSERT_THROW(planner.plan({ {8000, 0}, {8000, 0} }), Error);
+}
+
+
+TEST(MappingPlanner, bit_packed)
+{
+    MappingPlanner planner;
+    planner.setPacking(MappingPlanner::BIT_PACKED);
+    auto plan = planner.plan({ {2, 1}, {2, 2}, {5, 0}, {8, 8} });
+
+    ASSERT_EQ(1, plan.frames.size());
+    ASSERT_EQ(3, plan.frames[0].size);
+
+    ASSERT_EQ(0, plan.inputs[0].address);
+    ASSERT_EQ(0, plan.inputs[0].start_bit);
+    ASSERT_TRUE(plan.inputs[0].is_bit_packed);
+    ASSERT_EQ(0, plan.inputs[1].address);
+    ASSERT_EQ(2, plan.inputs[1].start_bit);
+    ASSERT_EQ(2, plan.outputs[1].start_bit);
+    ASSERT_EQ(1, plan.inputs[2].address);   // does not fit in the remaining bits
+    ASSERT_EQ(0, plan.inputs[2].start_bit);
+    ASSERT_EQ(2, plan.inputs[3].address);
+    ASSERT_FALSE(plan.inputs[3].is_bit_packed);
+}
+
+
+TEST(MappingPlanner, wire_time)
+{
+    MappingPlanner planner;
+    auto plan = planner.plan({ {800, 800} });
+
+    // 100 bytes of data in one LRW: 112 bytes datagram + EtherCAT and Ethernet headers + FCS + preamble + IFG
+    ASSERT_EQ(1,   plan.datagrams);
+    ASSERT_EQ(1,   plan.ethernet_frames);
+    ASSERT_EQ(152, plan.wire_bytes);
+    ASSERT_EQ(12160ns, plan.wire_time);
+
+    // small frames are padded
+    plan = planner.plan({ {8, 8} });
+    ASSERT_EQ(84, plan.wire_bytes);
+}
@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+#include "kickcat/PDOLayout.h"
+
+using namespace kickcat;
+
+using Inputs = PDOLayout<Field<uint16_t>,       // status word
+                         Field<int32_t>,        // position
+                         Field<bool, 1>,        // digital input
+                         Field<uint8_t, 3>,     // counter
+                         Gap<3>,
+                         Field<float>>;         // not byte aligned
+
+static_assert(Inputs::bits  == 87);
+static_assert(Inputs::bytes == 11);
+static_assert(Inputs::offset<1>() == 16);
+static_assert(Inputs::offset<3>() == 49);
+static_assert(Inputs::offset<5>() == 55);
+static_assert(Inputs::size<3>() == 3);
+
+
+TEST(PDOLayout, get_set)
+{
+    uint8_t data[Inputs::bytes] = {0};
+
+    Inputs::set<0>(data, 0x1234);
+    Inputs::set<1>(data, -42);
+    Inputs::set<2>(data, true);
+    Inputs::set<3>(data, 5);
+    Inputs::set<5>(data, 1.5f);
+
+    ASSERT_EQ(0x34, data[0]);
+    ASSERT_EQ(0x12, data[1]);
+    ASSERT_EQ(0x0B, data[6]);   // 1 + (5 << 1)
+
+    ASSERT_EQ(0x1234, Inputs::get<0>(data));
+    ASSERT_EQ(-42,    Inputs::get<1>(data));
+    ASSERT_TRUE(Inputs::get<2>(data));
+    ASSERT_EQ(5,      Inputs::get<3>(data));
+    ASSERT_EQ(1.5f,   Inputs::get<5>(data));
+
+    // neighbours are left untouched
+    Inputs::set<2>(data, false);
+    ASSERT_FALSE(Inputs::get<2>(data));
+    ASSERT_EQ(5, Inputs::get<3>(data));
+    ASSERT_EQ(1.5f, Inputs::get<5>(data));
+}
+
+
+TEST(PDOLayout, check)
+{
+    Slave::PIMapping mapping{nullptr, 87, 11, 3, 0, 0, false};
+    Inputs::check(mapping);
+
+    mapping.size = 96;
+    ASSERT_THROW(Inputs::check(mapping), Error);
+
+    using Outputs = PDOLayout<Field<uint16_t>, Field<uint8_t, 4>, Gap<4>>;
+    eeprom::PDOEntry control_word{0x6040, 0, 0, 0, 16, 0};
+    eeprom::PDOEntry mode        {0x6060, 0, 0, 0, 4,  0};
+    eeprom::PDOEntry padding     {0x0000, 0, 0, 0, 4,  0};
+    eeprom::PDOEntry mode_display{0x6061, 0, 0, 0, 8,  0};
+    Outputs::check({&control_word, &mode, &padding});
+
+    ASSERT_THROW(Outputs::check({&control_word, &mode}), Error);
+    ASSERT_THROW(Outputs::check({&control_word, &mode_display, &padding}), Error);
+}
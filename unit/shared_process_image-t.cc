@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <thread>
+
+#include "kickcat/SharedProcessImage.h"
+
+using namespace kickcat;
+
+TEST(TripleBuffer, publish_acquire)
+{
+    TripleBuffer buffer(4);
+    ASSERT_EQ(4, buffer.size());
+    ASSERT_FALSE(buffer.acquire());
+
+    std::memset(buffer.writeBuffer(), 1, 4);
+    buffer.publish();
+    std::memset(buffer.writeBuffer(), 2, 4);
+    buffer.publish();   // older publication is dropped
+
+    ASSERT_TRUE(buffer.acquire());
+    ASSERT_EQ(2, buffer.readBuffer()[0]);
+    ASSERT_FALSE(buffer.acquire());
+    ASSERT_EQ(2, buffer.readBuffer()[3]);
+
+    // producer never writes in the buffer being read
+    std::memset(buffer.writeBuffer(), 3, 4);
+    ASSERT_EQ(2, buffer.readBuffer()[0]);
+    buffer.publish();
+    std::memset(buffer.writeBuffer(), 4, 4);
+    ASSERT_EQ(2, buffer.readBuffer()[0]);
+
+    ASSERT_TRUE(buffer.acquire());
+    ASSERT_EQ(3, buffer.readBuffer()[0]);
+}
+
+
+TEST(TripleBuffer, no_torn_data)
+{
+    constexpr int32_t SIZE = 1024;
+    constexpr int32_t ITERATIONS = 20000;
+    TripleBuffer buffer(SIZE);
+
+    std::thread producer([&]()
+    {
+        for (int32_t i = 1; i <= ITERATIONS; ++i)
+        {
+            std::memset(buffer.writeBuffer(), i & 0xFF, SIZE);
+            buffer.publish();
+        }
+    });
+
+    int32_t torn = 0;
+    for (int32_t i = 0; i < ITERATIONS; ++i)
+    {
+        buffer.acquire();
+        uint8_t const* data = buffer.readBuffer();
+        for (int32_t j = 1; j < SIZE; ++j)
+        {
+            if (data[j] != data[0])
+            {
+                ++torn;
+                break;
+            }
+        }
+    }
+    producer.join();
+
+    ASSERT_EQ(0, torn);
+}
+
+
+TEST(SharedProcessImage, exchange)
+{
+    // iomap as built by Bus::createMapping(): inputs first, outputs second
+    uint8_t iomap[6] = {0x10, 0x11, 0x12, 0x20, 0x21, 0x22};
+    Slave slave;
+    slave.input.data  = iomap + 1;
+    slave.output.data = iomap + 4;
+
+    SharedProcessImage pi(iomap, 3, 3);
+
+    // outputs start from the client buffer content
+    ASSERT_EQ(0x21, *pi.outputs(slave));
+    ASSERT_FALSE(pi.acquireOutputs());
+
+    // cyclic thread publishes the inputs of the cycle
+    pi.publishInputs();
+    iomap[1] = 0xAA;    // next cycle answer, not published yet
+    ASSERT_TRUE(pi.acquireInputs());
+    ASSERT_EQ(0x11, *pi.inputs(slave));
+    ASSERT_EQ(0x10, pi.inputs()[0]);
+    ASSERT_FALSE(pi.acquireInputs());
+
+    // outputs are copied in the client buffer only once committed
+    *pi.outputs(slave) = 0xBB;
+    ASSERT_FALSE(pi.acquireOutputs());
+    ASSERT_EQ(0x21, iomap[4]);
+    pi.commitOutputs();
+    ASSERT_TRUE(pi.acquireOutputs());
+    ASSERT_EQ(0xBB, iomap[4]);
+    ASSERT_EQ(0x20, iomap[3]);
+
+    // a new outputs set starts from the committed one
+    ASSERT_EQ(0xBB, *pi.outputs(slave));
+    pi.outputs()[0] = 0xCC;
+    pi.commitOutputs();
+    ASSERT_TRUE(pi.acquireOutputs());
+    ASSERT_EQ(0xCC, iomap[3]);
+    ASSERT_EQ(0xBB, iomap[4]);
+}
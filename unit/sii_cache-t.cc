@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+#include "kickcat/Bus.h"
+#include "kickcat/SIICache.h"
+#include "ESCSlavesSocket.h"
+
+using namespace kickcat;
+
+class SIICacheTest : public testing::Test
+{
+public:
+    void SetUp() override
+    {
+        std::string pattern = testing::TempDir() + "kickcat_sii_XXXXXX";
+        std::vector<char> path(pattern.begin(), pattern.end());
+        path.push_back(0);
+        ASSERT_NE(nullptr, mkdtemp(path.data()));
+        directory = path.data();
+    }
+
+    void TearDown() override
+    {
+        for (auto const& entry : entries)
+        {
+            std::remove(entry.c_str());
+        }
+        rmdir(directory.c_str());
+    }
+
+    // init a bus on emulated slaves: \return the frames sent
+    int32_t init(std::vector<std::vector<uint16_t>> const& chain, std::vector<Slave>& slaves)
+    {
+        auto socket = std::make_shared<ESCSlavesSocket>();
+        for (auto const& sii : chain)
+        {
+            socket->addSlave(sii);
+        }
+
+        Bus bus(socket);
+        bus.configureWaitLatency(0ns, 10ms);
+        bus.setSIICache(directory);
+        bus.init();
+
+        SIICache cache(directory);
+        for (auto const& slave : bus.slaves())
+        {
+            entries.push_back(cache.path(slave));
+        }
+        slaves = bus.slaves();
+        return socket->frames;
+    }
+
+protected:
+    std::string directory;
+    std::vector<std::string> entries;
+};
+
+
+TEST_F(SIICacheTest, store_load)
+{
+    SIICache cache(directory);
+    ASSERT_TRUE(cache.isEnabled());
+    ASSERT_FALSE(SIICache().isEnabled());
+
+    Slave slave{};
+    slave.vendor_id       = 0x6A5;
+    slave.product_code    = 0x1234;
+    slave.revision_number = 2;
+    slave.serial_number   = 42;
+    slave.eeprom_crc      = 0x00A5;
+    slave.eeprom_size     = 256;
+    slave.sii.buffer = {0x0002000A, 0x00000000, 0xFFFFFFFF};
+    entries.push_back(cache.path(slave));
+
+    Slave same = slave;
+    same.sii.buffer.clear();
+    ASSERT_FALSE(cache.load(same));
+
+    cache.store(slave);
+    ASSERT_TRUE(cache.load(same));
+    ASSERT_EQ(slave.sii.buffer, same.sii.buffer);
+
+    // checksum mismatch: another entry
+    Slave other = slave;
+    other.sii.buffer.clear();
+    other.eeprom_crc = 0x005A;
+    ASSERT_FALSE(cache.load(other));
+
+    // truncated entry
+    FILE* file = fopen(cache.path(slave).c_str(), "r+b");
+    ASSERT_NE(nullptr, file);
+    ASSERT_EQ(0, ftruncate(fileno(file), 12));
+    fclose(file);
+    ASSERT_FALSE(cache.load(same));
+
+    // corrupted size: bigger than the slave EEPROM
+    cache.store(slave);
+    file = fopen(cache.path(slave).c_str(), "r+b");
+    ASSERT_NE(nullptr, file);
+    uint32_t size = 0xFFFFFFF0;
+    ASSERT_EQ(0, fseek(file, sizeof(uint32_t), SEEK_SET));
+    ASSERT_EQ(1, fwrite(&size, sizeof(size), 1, file));
+    fclose(file);
+    ASSERT_FALSE(cache.load(same));
+}
+
+
+TEST_F(SIICacheTest, bus_init)
+{
+    std::vector<std::vector<uint16_t>> chain;
+    for (uint16_t i = 0; i < 4; ++i)
+    {
+        chain.push_back(ESCSlavesSocket::createSII(0x6A5, 0x100 + i, 64 * i));
+    }
+
+    std::vector<Slave> fetched;
+    int32_t full_frames = init(chain, fetched);
+    ASSERT_EQ(4, entries.size());
+
+    // known slaves: identity only
+    std::vector<Slave> cached;
+    int32_t cached_frames = init(chain, cached);
+    ASSERT_LT(cached_frames, full_frames);
+    for (std::size_t i = 0; i < fetched.size(); ++i)
+    {
+        ASSERT_EQ(fetched[i].sii.buffer, cached[i].sii.buffer);
+        ASSERT_EQ(4, cached[i].sii.syncManagers_.size());
+        ASSERT_EQ(0x1200, cached[i].sii.syncManagers_.at(3)->start_adress);
+    }
+
+    // rewritten SII of the longest one (new checksum): fully fetched again
+    chain[3] = ESCSlavesSocket::createSII(0x6A5, 0x103, 64 * 3);
+    chain[3][eeprom::ESC_CRC] = 0x005A;
+    chain[3][eeprom::START_CATEGORY + 2] = 0x0108;  // first string bytes
+    std::vector<Slave> updated;
+    int32_t updated_frames = init(chain, updated);
+    ASSERT_EQ(full_frames, updated_frames);
+    ASSERT_EQ(0x0108, updated[3].sii.buffer.at(1) & 0xFFFF);
+}
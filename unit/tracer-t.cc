@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "kickcat/Bus.h"
+#include "kickcat/Tracer.h"
+#include "ESCSlavesSocket.h"
+
+using namespace kickcat;
+
+TEST(Tracer, scope_and_save)
+{
+    Tracer tracer;
+    {
+        Tracer::Scope disabled(nullptr, "nothing");
+        Tracer::Scope enabled(&tracer, "phase");
+        sleep(100us);
+    }
+    tracer.add("quoted \"name\"", "test", 1000ns, 3500ns, Tracer::SLAVE + 4);
+    tracer.add("late", "test", 1'700'000'000'123'456'789ns, 1'700'000'000'123'456'790ns, Tracer::SLAVE + 4);
+    ASSERT_EQ(3, tracer.events().size());
+    ASSERT_EQ("phase", tracer.events()[0].name);
+    ASSERT_LE(100us, tracer.events()[0].duration);
+    ASSERT_EQ(Tracer::BUS, tracer.events()[0].lane);
+
+    std::string path = testing::TempDir() + "kickcat_trace.json";
+    tracer.save(path);
+    std::ifstream file(path);
+    std::stringstream content;
+    content << file.rdbuf();
+    std::remove(path.c_str());
+
+    std::string json = content.str();
+    ASSERT_EQ(0, json.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+    ASSERT_NE(std::string::npos, json.find("\"name\":\"slave 4\""));
+    ASSERT_NE(std::string::npos, json.find("{\"name\":\"quoted \\\"name\\\"\",\"cat\":\"test\",\"ph\":\"X\",\"pid\":1,\"tid\":6,\"ts\":0.000,\"dur\":2.500}"));
+    ASSERT_NE(std::string::npos, json.find("\"ts\":1700000000123455.789,\"dur\":0.001}"));  // exact nanoseconds
+    ASSERT_EQ("]}\n", json.substr(json.size() - 3));
+
+    tracer.clear();
+    ASSERT_TRUE(tracer.events().empty());
+    ASSERT_THROW(tracer.save("/nonexistent/trace.json"), std::system_error);
+}
+
+
+TEST(Tracer, bus_init)
+{
+    auto socket = std::make_shared<ESCSlavesSocket>();
+    for (int32_t i = 0; i < 3; ++i)
+    {
+        socket->addSlave(ESCSlavesSocket::createSII(0x6A5, i, 0));
+    }
+
+    Tracer tracer;
+    Bus bus(socket);
+    bus.configureWaitLatency(0ns, 10ms);
+    bus.setTracer(&tracer);
+    bus.init();
+
+    auto count = [&tracer](std::string const& name, int32_t lane)
+    {
+        int32_t found = 0;
+        for (auto const& event : tracer.events())
+        {
+            if ((event.name.find(name) == 0) and (event.lane == lane))
+            {
+                ++found;
+            }
+        }
+        return found;
+    };
+    ASSERT_EQ(1, count("init", Tracer::BUS));
+    ASSERT_EQ(1, count("detectSlaves", Tracer::BUS));
+    ASSERT_EQ(1, count("resetSlaves", Tracer::BUS));
+    ASSERT_EQ(1, count("fetchEeprom", Tracer::BUS));
+    ASSERT_EQ(2, count("waitForState", Tracer::BUS));
+    ASSERT_LE(2, count("isStateReached", Tracer::BUS));
+    ASSERT_LT(0, count("readEeprom 0x", Tracer::SLAVE + 2));
+    ASSERT_EQ(socket->frames, count("frame", Tracer::LINK));
+
+    // the init event covers the whole init
+    Tracer::Event const& init = tracer.events().back();
+    ASSERT_EQ("init", init.name);
+    for (auto const& event : tracer.events())
+    {
+        ASSERT_LE(init.start, event.start);
+        ASSERT_GE(init.start + init.duration, event.start + event.duration);
+    }
+
+    // disabled: nothing recorded
+    tracer.clear();
+    bus.setTracer(nullptr);
+    bus.init();
+    ASSERT_TRUE(tracer.events().empty());
+}